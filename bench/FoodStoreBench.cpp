@@ -0,0 +1,80 @@
+// Compares the AoS Object::dist loop World used to run against the FoodStore kernels.
+// build: g++ -std=c++20 -O2 -Isrc bench/FoodStoreBench.cpp src/game/FoodStore.cpp -o food-store-bench
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "game/FoodStore.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+// the loop from World::checkCollision before the lanes existed
+const ItemObj* firstHitAoS(const std::vector<ItemObj>& objects, Object obj) {
+	for (auto& object : objects) {
+		if (object.item == Item::None) continue;
+
+		if (obj.dist(object) <= 0.0) return &object;
+	}
+	return nullptr;
+}
+
+size_t allHitsAoS(const std::vector<ItemObj>& objects, Object obj, std::vector<uint32_t>& out) {
+	for (size_t i = 0; i < objects.size(); ++i) {
+		if (objects[i].item == Item::None) continue;
+
+		if (obj.dist(objects[i]) <= 0.0) out.push_back((uint32_t) i);
+	}
+	return out.size();
+}
+
+template <class F>
+double timeNs(int reps, F&& f) {
+	auto start = Clock::now();
+	for (int i = 0; i < reps; ++i) f();
+	return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / reps;
+}
+
+int main() {
+	constexpr size_t foodCounts[] = { 1000, 100000, 1000000 };
+	constexpr const char* kernelNames[] = { "scalar", "sse2", "avx2" };
+
+	std::default_random_engine re(42);
+	std::uniform_real_distribution<float> coord(-63.0f, 63.0f);
+
+	std::printf("%10s %-8s %16s %16s\n", "foods", "kernel", "first miss (ns)", "all hits (ns)");
+
+	for (size_t foods : foodCounts) {
+		std::vector<ItemObj> objects;
+		FoodStore store;
+		for (size_t i = 0; i < foods; ++i) {
+			// sprinkle in some eaten items so the tombstone test isn't free
+			ItemObj obj{ glm::vec3(coord(re), coord(re), coord(re)), 0.5f, i % 64 == 0 ? Item::None : Item::Food };
+			objects.push_back(obj);
+			store.push(obj);
+		}
+
+		// outside the arena so first hit has to look at everything
+		Object miss{ glm::vec3(100.0f), 0.5f };
+		// big enough to hit a few percent of the foods
+		Object wide{ glm::vec3(0.0f), 16.0f };
+
+		int reps = (int) (200000000 / foods / 10) + 1;
+		std::vector<uint32_t> out;
+		out.reserve(foods);
+
+		volatile size_t sink = 0;
+		double missNs = timeNs(reps, [&] { sink = sink + (firstHitAoS(objects, miss) != nullptr); });
+		double allNs = timeNs(reps, [&] { out.clear(); sink = sink + allHitsAoS(objects, wide, out); });
+		std::printf("%10zu %-8s %16.0f %16.0f\n", foods, "aos", missNs, allNs);
+
+		for (int k = 0; k < 3; ++k) {
+			auto kernel = (FoodStore::Kernel) k;
+			if (!FoodStore::useKernel(kernel)) continue;
+
+			missNs = timeNs(reps, [&] { sink = sink + store.firstHit(miss); });
+			allNs = timeNs(reps, [&] { out.clear(); store.allHits(wide, out); sink = sink + out.size(); });
+			std::printf("%10zu %-8s %16.0f %16.0f\n", foods, kernelNames[k], missNs, allNs);
+		}
+	}
+}
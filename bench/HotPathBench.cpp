@@ -0,0 +1,426 @@
+// Times the simulation and mesh hot paths one call at a time against synthetic worst cases, for tracking regressions.
+// usage: hot-path-bench [--json out.json] [--baseline old.json] [--filter name] [--min-time 0.2] [--label text]
+// build: g++ -std=c++20 -O2 -Isrc bench/HotPathBench.cpp src/MathUtils.cpp src/game/FoodStore.cpp -pthread -o hot-path-bench
+//
+// every case is run in batches until a batch takes min-time / samples, then timed for samples batches, the median and
+// the fastest batch are reported in ns per call. the json has one case per line, --baseline reads a file written
+// earlier and prints how each case moved, exiting with 1 if any got slower than the threshold
+
+#include <map>
+#include <limits>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+
+#include "mesh.hpp"
+#include "game/Game.hpp"
+#include "game/Random.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+	std::string json;
+	std::string baseline;
+	std::string filter;
+	std::string label;
+	double minTime = 0.2;
+	// slower than the baseline by more than this fraction counts as a regression
+	double threshold = 0.15;
+};
+
+struct Result {
+	// name/param=value/..., what baselines are matched on
+	std::string id;
+	std::string name;
+	std::vector<std::pair<std::string, std::string>> params;
+	// measured facts about the scenario, kept out of the id so changes to them don't break matching
+	std::vector<std::pair<std::string, std::string>> context;
+	uint64_t calls;
+	double medianNs;
+	double minNs;
+};
+
+// results of calls go here so the optimizer can't drop them
+static volatile double sink;
+
+class Runner {
+private:
+	const Options& options;
+
+	static constexpr int samples = 5;
+
+public:
+	std::vector<Result> results;
+	// goes with every case run until it's changed
+	std::vector<std::pair<std::string, std::string>> context;
+
+	explicit Runner(const Options& options) : options(options) {}
+
+	// batch(n) makes n calls and returns something derived from their results
+	template <class F>
+	void run(const std::string& name, std::vector<std::pair<std::string, std::string>> params, F&& batch) {
+		std::string id = name;
+		for (const auto& [key, value] : params) id += "/" + key + "=" + value;
+		if (!options.filter.empty() && id.find(options.filter) == std::string::npos) return;
+
+		auto time = [&](uint64_t n) {
+			auto start = Clock::now();
+			sink = sink + (double) batch(n);
+			return std::chrono::duration<double>(Clock::now() - start).count();
+		};
+
+		// also warms caches and the branch predictor
+		uint64_t n = 1;
+		double target = options.minTime / samples;
+		while (time(n) < target && n < (1ull << 40)) n *= 2;
+
+		std::vector<double> ns;
+		for (int i = 0; i < samples; ++i) ns.push_back(time(n) * 1e9 / (double) n);
+		std::sort(ns.begin(), ns.end());
+
+		results.push_back({ id, name, std::move(params), context, n * samples, ns[samples / 2], ns[0] });
+		std::printf("%-64s %14.1f %14.1f %12llu\n", id.c_str(), ns[samples / 2], ns[0], (unsigned long long) (n * samples));
+		std::fflush(stdout);
+	}
+};
+
+// --- scenarios ---
+
+// n unit segments in a line along z, head at the origin
+static std::vector<glm::vec3> straightPoints(int n) {
+	std::vector<glm::vec3> points;
+	for (int i = 0; i <= n; ++i) points.emplace_back(0.0f, 0.0f, (float) -i);
+	return points;
+}
+
+// n unit segments snaking back and forth through the smallest cube that holds them, every grid cell the body
+// touches is as crowded as a snake can make it, the worst case for anything that queries the body
+static std::vector<glm::vec3> coiledPoints(int n) {
+	int side = 1;
+	while (side * side * side < n + 1) ++side;
+
+	std::vector<glm::vec3> points;
+	for (int z = 0; z < side && (int) points.size() <= n; ++z) {
+		for (int y = 0; y < side && (int) points.size() <= n; ++y) {
+			// boustrophedon, every row runs back the way the last one came and every layer back the way the last one did
+			int row = z % 2 == 0 ? y : side - 1 - y;
+			for (int x = 0; x < side && (int) points.size() <= n; ++x) {
+				int column = (z * side + y) % 2 == 0 ? x : side - 1 - x;
+				points.emplace_back((float) column, (float) row, (float) z);
+			}
+		}
+	}
+	// centered on the origin so it fits in the arena
+	glm::vec3 center((float) (side - 1) * 0.5f);
+	for (auto& point : points) point -= center;
+	return points;
+}
+
+static std::vector<glm::vec3> snakePoints(const std::string& shape, int n) {
+	return shape == "coiled" ? coiledPoints(n) : straightPoints(n);
+}
+
+// spheres spread over the box points span, padded by a little so some queries miss everything
+static std::vector<Object> queriesAround(const std::vector<glm::vec3>& points, float radius, size_t count) {
+	glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+	for (auto point : points) {
+		lo = glm::min(lo, point);
+		hi = glm::max(hi, point);
+	}
+	lo -= 2.0f;
+	hi += 2.0f;
+
+	CounterRng rng(11, 0);
+	std::vector<Object> queries;
+	for (size_t i = 0; i < count; ++i) {
+		auto unit = [&] { return (float) ((double) rng.next() / 4294967296.0); };
+		glm::vec3 t(unit(), unit(), unit());
+		queries.push_back({ glm::mix(lo, hi, t), radius });
+	}
+	return queries;
+}
+
+// a default arena with about fill of its lattice cells holding food
+static std::unique_ptr<Game> filledGame(double fill) {
+	auto game = std::make_unique<Game>();
+	uint64_t cells = game->world.chunkCount() * OccupancyMap::cellCount;
+	game->generate(42, (uint64_t) (fill * (double) cells));
+	game->state = State::Playing;
+	return game;
+}
+
+static std::string format(double value) {
+	char text[32];
+	std::snprintf(text, sizeof(text), "%g", value);
+	return text;
+}
+
+// plain memory standing in for the mapped buffer the game fills
+struct MemoryBuffer {
+	std::vector<char8_t> memory;
+	char8_t* pointer;
+	size_t size = 0;
+
+	explicit MemoryBuffer(size_t bytes) : memory(bytes), pointer(memory.data()) {}
+};
+
+static void runAll(Runner& runner) {
+	constexpr int segmentCounts[] = { 10, 100, 1000, 10000 };
+	// foods on neighbouring cells touch, so a bit under a third of the cells is as full as an arena gets
+	constexpr double fills[] = { 0.01, 0.05, 0.15, 0.3 };
+
+	for (const char* shape : { "straight", "coiled" }) {
+		for (int segments : segmentCounts) {
+			auto points = snakePoints(shape, segments);
+			Snake snake(points, glm::vec2(0.0f));
+			auto queries = queriesAround(points, 0.5f, 1024);
+
+			runner.run("snake_dist", { { "shape", shape }, { "segments", std::to_string(segments) } }, [&](uint64_t n) {
+				float total = 0.0f;
+				for (uint64_t i = 0; i < n; ++i) total += glm::min(snake.dist(queries[i & 1023]), 1.0f);
+				return total;
+			});
+		}
+	}
+
+	for (const char* shape : { "straight", "coiled" }) {
+		for (int segments : segmentCounts) {
+			auto points = snakePoints(shape, segments);
+			const Snake original(points, glm::vec2(0.0f));
+
+			// a tick's worth and several whole segments at once, a fresh copy comes in once the snake runs out
+			for (float step : { Snake::speed / 60.0f, 4.0f }) {
+				Snake snake = original;
+				runner.run("snake_shrink_len", { { "shape", shape }, { "segments", std::to_string(segments) }, { "step", format(step) } },
+					[&](uint64_t n) {
+						for (uint64_t i = 0; i < n; ++i) {
+							if (snake.segments.size() <= 2) snake = original;
+							snake.shrinkLen(step);
+						}
+						return snake.segments.size();
+					});
+			}
+		}
+	}
+
+	for (double fill : fills) {
+		auto game = filledGame(fill);
+		auto& world = game->world;
+		double loaded = (double) world.foodCount() / (double) (world.chunkCount() * OccupancyMap::cellCount);
+		runner.context = { { "loaded_fill", format(loaded) }, { "foods", std::to_string(world.foodCount()) } };
+
+		// a head, and a sphere wide enough that the lane scan takes over at high fill
+		for (float radius : { Snake::radius, 8.0f }) {
+			std::vector<glm::vec3> corners = { glm::vec3((float) -world.half), glm::vec3((float) world.half) };
+			auto queries = queriesAround(corners, radius, 1024);
+			const World& view = world;
+
+			runner.run("world_check_collision", { { "fill", format(fill) }, { "radius", format(radius) } }, [&](uint64_t n) {
+				size_t hits = 0;
+				for (uint64_t i = 0; i < n; ++i) hits += view.checkCollision(queries[i & 1023]) != nullptr;
+				return hits;
+			});
+		}
+
+		std::vector<uint32_t> foods;
+		for (uint32_t i = 0; i < world.objects.size(); ++i) {
+			if (world.objects[i].item == Item::Food) foods.push_back(i);
+		}
+		CounterRng rng(13, 0);
+		std::vector<uint32_t> order;
+		for (int i = 0; i < 4096; ++i) order.push_back(foods[rng.below((uint32_t) foods.size())]);
+
+		// what eating does, moved foods stay in their chunk so the fill doesn't drift
+		runner.run("world_move_obj", { { "fill", format(fill) } }, [&](uint64_t n) {
+			for (uint64_t i = 0; i < n; ++i) {
+				auto& obj = world.objects[order[i & 4095]];
+				if (obj.item == Item::Food) world.moveObj(obj, game->snakeSet());
+			}
+			return world.objects[order[0]].pos.x;
+		});
+	}
+
+	runner.context.clear();
+
+	// a whole snake a call, what setupMesh writes for the snake body shader
+	for (int segments : segmentCounts) {
+		auto points = coiledPoints(segments);
+		Snake snake(points, glm::vec2(0.0f));
+		MemoryBuffer buffer(points.size() * snakePointSize);
+
+		runner.run("fill_snake_points", { { "segments", std::to_string(segments) } }, [&](uint64_t n) {
+			for (uint64_t i = 0; i < n; ++i) {
+				buffer.size = 0;
+				fillSnakePoints(snake.interpolated(0.5f), buffer, SnakeColor::Other);
+			}
+			return buffer.pointer[0];
+		});
+	}
+
+	// a frame of foods in a row, what setupMesh writes for the instanced draw
+	for (size_t foodsPerFrame : { (size_t) 1000, (size_t) 100000 }) {
+		MemoryBuffer buffer(foodsPerFrame * foodInstanceSize);
+		auto queries = queriesAround({ glm::vec3(-64.0f), glm::vec3(64.0f) }, World::foodRadius, 1024);
+
+		runner.run("fill_food_instance", { { "foods_per_frame", std::to_string(foodsPerFrame) } }, [&](uint64_t n) {
+			for (uint64_t i = 0; i < n; ++i) {
+				if (buffer.size == buffer.memory.size()) buffer.size = 0;
+				const auto& food = queries[i & 1023];
+				fillFoodInstance(buffer, food.pos, food.radius, FoodColor::Red);
+			}
+			return buffer.pointer[0];
+		});
+	}
+}
+
+// --- json ---
+
+static std::string escape(const std::string& text) {
+	std::string out;
+	for (char c : text) {
+		if (c == '"' || c == '\\') out += '\\';
+		out += c;
+	}
+	return out;
+}
+
+static void writeJson(std::FILE* file, const Options& options, const std::vector<Result>& results) {
+#if defined(_MSC_VER)
+	std::string compiler = "msvc " + std::to_string(_MSC_VER);
+#elif defined(__clang__)
+	std::string compiler = std::string("clang ") + __clang_version__;
+#elif defined(__GNUC__)
+	std::string compiler = std::string("gcc ") + __VERSION__;
+#else
+	std::string compiler = "unknown";
+#endif
+#ifdef NDEBUG
+	const char* build = "release";
+#else
+	const char* build = "debug";
+#endif
+	auto now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+	std::fprintf(file, "{\n");
+	std::fprintf(file, "\"label\": \"%s\", \"compiler\": \"%s\", \"build\": \"%s\", \"unix_time\": %lld, \"min_time\": %g,\n",
+		escape(options.label).c_str(), escape(compiler).c_str(), build, (long long) now, options.minTime);
+	std::fprintf(file, "\"results\": [\n");
+	for (size_t i = 0; i < results.size(); ++i) {
+		const auto& result = results[i];
+		auto object = [](const std::vector<std::pair<std::string, std::string>>& pairs) {
+			std::string out;
+			for (const auto& [key, value] : pairs) {
+				if (!out.empty()) out += ", ";
+				out += "\"" + escape(key) + "\": \"" + escape(value) + "\"";
+			}
+			return "{" + out + "}";
+		};
+		std::fprintf(file, "{\"id\": \"%s\", \"name\": \"%s\", \"params\": %s, \"context\": %s, \"calls\": %llu, \"median_ns\": %.3f, \"min_ns\": %.3f}%s\n",
+			escape(result.id).c_str(), escape(result.name).c_str(), object(result.params).c_str(), object(result.context).c_str(),
+			(unsigned long long) result.calls,
+			result.medianNs, result.minNs, i + 1 < results.size() ? "," : "");
+	}
+	std::fprintf(file, "]\n}\n");
+}
+
+// only reads what writeJson writes, one result per line
+static std::map<std::string, double> readBaseline(const std::string& path) {
+	std::map<std::string, double> medians;
+	std::ifstream file(path);
+	std::string line;
+	while (std::getline(file, line)) {
+		constexpr const char* idKey = "{\"id\": \"";
+		constexpr const char* medianKey = "\"median_ns\": ";
+		if (line.rfind(idKey, 0) != 0) continue;
+
+		size_t idStart = std::strlen(idKey);
+		size_t idEnd = line.find('"', idStart);
+		size_t median = line.find(medianKey);
+		if (idEnd == std::string::npos || median == std::string::npos) continue;
+
+		medians[line.substr(idStart, idEnd - idStart)] = std::strtod(line.c_str() + median + std::strlen(medianKey), nullptr);
+	}
+	return medians;
+}
+
+// returns how many cases got slower than the threshold
+static int compare(const Options& options, const std::vector<Result>& results) {
+	auto baseline = readBaseline(options.baseline);
+	if (baseline.empty()) {
+		std::fprintf(stderr, "no results in baseline %s\n", options.baseline.c_str());
+		return 1;
+	}
+
+	int regressions = 0;
+	std::printf("\n%-64s %14s %14s %9s\n", "vs baseline", "before (ns)", "after (ns)", "change");
+	for (const auto& result : results) {
+		auto it = baseline.find(result.id);
+		if (it == baseline.end() || it->second <= 0.0) continue;
+
+		double change = result.medianNs / it->second - 1.0;
+		bool regressed = change > options.threshold;
+		regressions += regressed;
+		std::printf("%-64s %14.1f %14.1f %+8.1f%%%s\n", result.id.c_str(), it->second, result.medianNs, change * 100.0,
+			regressed ? " REGRESSED" : "");
+	}
+	return regressions;
+}
+
+static bool parseOptions(int argc, char** argv, Options& options) {
+	for (int i = 1; i < argc; ++i) {
+		const char* arg = argv[i];
+		if (i + 1 >= argc) {
+			std::fprintf(stderr, "missing value for %s\n", arg);
+			return false;
+		}
+		const char* value = argv[++i];
+
+		try {
+			if (std::strcmp(arg, "--json") == 0) options.json = value;
+			else if (std::strcmp(arg, "--baseline") == 0) options.baseline = value;
+			else if (std::strcmp(arg, "--filter") == 0) options.filter = value;
+			else if (std::strcmp(arg, "--label") == 0) options.label = value;
+			else if (std::strcmp(arg, "--min-time") == 0) options.minTime = std::stod(value);
+			else if (std::strcmp(arg, "--threshold") == 0) options.threshold = std::stod(value);
+			else {
+				std::fprintf(stderr, "unknown option %s\n", arg);
+				return false;
+			}
+		} catch (const std::exception&) {
+			std::fprintf(stderr, "bad value for %s: %s\n", arg, value);
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	if (!parseOptions(argc, argv, options)) return 1;
+
+	Runner runner(options);
+	std::printf("%-64s %14s %14s %12s\n", "case", "median (ns)", "min (ns)", "calls");
+	runAll(runner);
+
+	// before the json is written, --json and --baseline may well be the same file
+	int regressions = 0;
+	if (!options.baseline.empty()) regressions = compare(options, runner.results);
+
+	if (!options.json.empty()) {
+		std::FILE* file = options.json == "-" ? stdout : std::fopen(options.json.c_str(), "w");
+		if (!file) {
+			std::fprintf(stderr, "can't write %s\n", options.json.c_str());
+			return 1;
+		}
+		writeJson(file, options, runner.results);
+		if (file != stdout) std::fclose(file);
+	}
+
+	return regressions > 0 ? 1 : 0;
+}
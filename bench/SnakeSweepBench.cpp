@@ -0,0 +1,99 @@
+// Measures the snake vs snake broadphase against testing every head against every segment of every other snake.
+// build: g++ -std=c++20 -O2 -Isrc bench/SnakeSweepBench.cpp src/MathUtils.cpp src/game/FoodStore.cpp -pthread -o snake-sweep-bench
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <vector>
+#include "game/Game.hpp"
+#include "game/Random.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static glm::vec2 randomRotation(CounterRng& rng) {
+	float yaw = (float) rng.below(4) * 90.0f;
+	float pitch = ((float) rng.below(3) - 1.0f) * 90.0f;
+	return glm::vec2(pitch == 0.0f ? yaw : 0.0f, pitch);
+}
+
+static Snake randomSnake(CounterRng& rng) {
+	auto coord = [&] { return (float) rng.below(81) - 40.0f; };
+	return Snake(glm::vec3(coord(), coord(), coord()), randomRotation(rng));
+}
+
+// what SnakeSweep replaces, O(snakes * segments)
+static void naiveBitten(const std::vector<Snake>& snakes, std::vector<uint8_t>& out) {
+	out.assign(snakes.size(), 0);
+	for (size_t i = 0; i < snakes.size(); ++i) {
+		if (snakes[i].segments.size() < 2) continue;
+		glm::vec3 from = snakes[i].moveStart();
+		glm::vec3 motion = snakes[i].segments.front() - from;
+
+		for (size_t j = 0; j < snakes.size() && !out[i]; ++j) {
+			const auto& other = snakes[j];
+			if (i == j) continue;
+
+			for (size_t k = 1; k < other.segments.size(); ++k) {
+				if (sweepCapsule(from, motion, other.segments[k - 1], other.segments[k], Snake::radius)) {
+					out[i] = 1;
+					break;
+				}
+			}
+		}
+	}
+}
+
+int main() {
+	constexpr int snakeCounts[] = { 100, 1000 };
+	constexpr double dt = 1.0 / 60.0;
+	constexpr int warmup = 60 * 10;
+	constexpr int ticks = 60 * 5;
+
+	std::printf("%8s %10s %14s %14s %14s %10s\n", "snakes", "segments", "sweep (us)", "naive (us)", "speedup", "mismatch");
+
+	for (int count : snakeCounts) {
+		auto game = std::make_unique<Game>();
+		CounterRng rng(7, 0);
+		for (int i = 1; i < count; ++i) game->addSnake(randomSnake(rng));
+		game->state = State::Playing;
+
+		// snakes that run into each other get replaced, so the arena stays full and the shapes stay realistic
+		auto advance = [&] {
+			for (auto& snake : game->snakes) {
+				if (rng.below(30) == 0) snake.setRotation(randomRotation(rng));
+			}
+			game->tick(dt);
+			for (size_t s = 0; s < game->snakes.size(); ++s) {
+				if (game->lost[s] != LoseCode::None) game->respawn(s, randomSnake(rng));
+			}
+			game->state = State::Playing;
+		};
+
+		for (int i = 0; i < warmup; ++i) advance();
+
+		SnakeSweep sweep;
+		auto all = [](size_t) { return true; };
+		std::vector<uint8_t> fast, slow;
+		double sweepUs = 0.0, naiveUs = 0.0;
+		size_t mismatches = 0, segments = 0;
+
+		for (int i = 0; i < ticks; ++i) {
+			advance();
+
+			auto start = Clock::now();
+			sweep.update(game->snakes, all);
+			sweep.bitten(game->snakes, fast);
+			sweepUs += std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+			start = Clock::now();
+			naiveBitten(game->snakes, slow);
+			naiveUs += std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+			for (size_t s = 0; s < fast.size(); ++s) mismatches += fast[s] != slow[s];
+			segments += sweep.size() - game->snakes.size();
+		}
+
+		std::printf("%8d %10zu %14.1f %14.1f %13.1fx %10zu\n", count, segments / ticks, sweepUs / ticks, naiveUs / ticks,
+			naiveUs / sweepUs, mismatches);
+	}
+}
@@ -0,0 +1,48 @@
+// Measures how Game::tick scales with the number of foods in the arena.
+// build: g++ -std=c++20 -O2 -Isrc bench/WorldBench.cpp src/MathUtils.cpp src/Profiler.cpp src/Simulation.cpp src/game/FoodStore.cpp
+//        src/game/MappedFile.cpp src/game/Parallel.cpp src/game/Replay.cpp src/game/Snapshot.cpp -pthread -o world-bench
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include "game/Game.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+int main() {
+	constexpr int foodCounts[] = { 100, 1000, 10000, 100000 };
+	constexpr double dt = 1.0 / 60.0;
+	constexpr int ticks = 60 * 20;
+
+	std::printf("%10s %14s %14s %14s\n", "foods", "place (ms)", "generate (ms)", "tick (ns)");
+
+	for (int foods : foodCounts) {
+		// World holds a 32^3 grid, keep it off the stack
+		auto game = std::make_unique<Game>();
+
+		auto generateStart = Clock::now();
+		game->generate(42, foods);
+		double generateMs = std::chrono::duration<double, std::milli>(Clock::now() - generateStart).count();
+
+		// placeFood only places into loaded chunks, so it gets a world of its own generated empty
+		auto placed = std::make_unique<Game>();
+		placed->generate(42, 0);
+		auto placeStart = Clock::now();
+		placed->placeFood(foods);
+		double placeMs = std::chrono::duration<double, std::milli>(Clock::now() - placeStart).count();
+
+		game->state = State::Playing;
+
+		auto tickStart = Clock::now();
+		for (int i = 0; i < ticks; ++i) {
+			game->tick(dt);
+			if (game->state == State::Overing) {
+				game->respawn(0);
+				game->state = State::Playing;
+			}
+		}
+		double tickNs = std::chrono::duration<double, std::nano>(Clock::now() - tickStart).count() / ticks;
+
+		std::printf("%10d %14.2f %14.2f %14.1f\n", foods, placeMs, generateMs, tickNs);
+	}
+}
@@ -7,6 +7,8 @@ layout(std140) uniform Global {
     mat4 inverseModelView;
     vec2 screenResolution;
     float tickDelta;
+    // walls at +-arenaHalf on every axis
+    float arenaHalf;
 };
 
 in vec4 color;
@@ -53,7 +55,7 @@ float dotNoise(vec3 coord, float fractionalMaxDotSize, float dDensity) {
 
 void main() {
 	fragColor = color;
-	fragColor.a += 0.8 * smoothstep(64.0, 100.0, length(rawPos));
+	fragColor.a += 0.8 * smoothstep(arenaHalf, arenaHalf * 1.5625, length(rawPos));
 	fragColor.rgb *= fragColor.a;
 	fragColor.a = 1.0;
 	fragColor.rgb += smoothstep(0.9, 1.0, dotNoise(rawPos, 2.0, 0.01));
@@ -0,0 +1,99 @@
+#version 460
+
+layout(local_size_x = 64) in;
+
+layout(std140) uniform Global {
+    mat4 projection;
+    mat4 modelView;
+    mat4 inverseProjection;
+    mat4 inverseModelView;
+    vec2 screenResolution;
+    float tickDelta;
+    // walls at +-arenaHalf on every axis
+    float arenaHalf;
+};
+
+// FoodObjectBuffer's instances, a float vec3 position then a half float radius and a FoodColor
+layout(std430, binding = 1) readonly buffer Objects {
+    uvec4 objects[];
+};
+// the ones in view, what the food draws read their instances from, one after the other by command
+layout(std430, binding = 2) writeonly buffer VisibleFoods {
+    uvec4 visible[];
+};
+// a DrawElementsIndirectCommand per mesh level and a DrawArraysIndirectCommand for the impostors after them,
+// instanceCounts start at 0, the count pass fills them in and the base pass turns them into baseInstances
+layout(std430, binding = 3) buffer DrawCommands {
+    uint commands[];
+};
+
+const uint levels = 3u;
+const uint impostors = levels * 5u;
+
+layout(location = 0) uniform uint objectCount;
+// FoodLevel::maxRadius of every mesh level, in pixels
+layout(location = 1) uniform float levelRadius[levels];
+// every frame runs all three in order, so visible only needs room for every object once
+const uint countPass = 0u;
+const uint basePass = 1u;
+const uint writePass = 2u;
+layout(location = 4) uniform uint cullPass;
+
+// false if the box is entirely outside one of the frustum's planes, which come straight out of the clip matrix's rows
+bool inFrustum(vec3 center, vec3 extent) {
+    mat4 rows = transpose(projection * modelView);
+    vec4 planes[6] = vec4[](
+        rows[3] + rows[0], rows[3] - rows[0],
+        rows[3] + rows[1], rows[3] - rows[1],
+        rows[3] + rows[2], rows[3] - rows[2]
+    );
+    for (int i = 0; i < 6; ++i) {
+        if (dot(planes[i].xyz, center) + planes[i].w < -dot(abs(planes[i].xyz), extent)) return false;
+    }
+    return true;
+}
+
+// index of the command that draws object, or none if it's out of view
+const uint none = 0xFFFFFFFFu;
+uint commandOf(uvec4 object) {
+    // empty slots have radius 0
+    float radius = unpackHalf2x16(object.w).x;
+    vec3 center = uintBitsToFloat(object.xyz);
+    if (radius <= 0.0 || !inFrustum(center, vec3(radius))) return none;
+
+    // radius on screen in pixels, foods too small for the first level to be worth it are impostors
+    float distance = length(center - inverseModelView[3].xyz);
+    float pixels = radius / max(distance, radius) * projection[1][1] * screenResolution.y * 0.5;
+    if (pixels < levelRadius[0] * 0.5) return impostors;
+
+    uint level = 0u;
+    while (level + 1u < levels && pixels > levelRadius[level]) level++;
+    return level * 5u;
+}
+
+uint baseInstanceOf(uint command) {
+    return command + (command == impostors ? 3u : 4u);
+}
+
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+    if (cullPass == basePass) {
+        // one invocation, the counts become where each command starts and count up again from 0 in the write pass
+        if (i != 0u) return;
+        uint start = 0u;
+        for (uint command = 0u; command <= impostors; command += 5u) {
+            commands[baseInstanceOf(command)] = start;
+            start += commands[command + 1u];
+            commands[command + 1u] = 0u;
+        }
+        return;
+    }
+    if (i >= objectCount) return;
+
+    uvec4 object = objects[i];
+    uint command = commandOf(object);
+    if (command == none) return;
+
+    uint slot = atomicAdd(commands[command + 1u], 1u);
+    if (cullPass == writePass) visible[commands[baseInstanceOf(command)] + slot] = object;
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#version 460
+
+layout(std140) uniform Global {
+    mat4 projection;
+    mat4 modelView;
+    mat4 inverseProjection;
+    mat4 inverseModelView;
+    vec2 screenResolution;
+    float tickDelta;
+    // walls at +-arenaHalf on every axis
+    float arenaHalf;
+};
+
+in vec3 worldPos;
+flat in vec4 sphere;
+flat in vec4 color;
+
+out vec4 fragColor;
+
+// lit like GenericDraw.frag
+const vec3 lightPos1 = vec3(0.16169041, 0.80845207, -0.5659165);
+const vec3 lightPos2 = vec3(-0.16169041, 0.80845207, 0.5659165);
+
+void main() {
+    vec3 eye = inverseModelView[3].xyz;
+    vec3 dir = normalize(worldPos - eye);
+    vec3 toEye = eye - sphere.xyz;
+    float along = dot(toEye, dir);
+    // squared distance of the ray from the center taken directly, b^2 - c loses the sphere to rounding this far out
+    vec3 closest = toEye - along * dir;
+    float inside = sphere.w * sphere.w - dot(closest, closest);
+    if (inside < 0.0) discard;
+
+    vec3 hit = eye + dir * (-along - sqrt(inside));
+    vec4 clip = projection * modelView * vec4(hit, 1.0);
+    gl_FragDepth = clip.z / clip.w * 0.5 + 0.5;
+
+    vec3 normal = normalize(transpose(mat3(inverseModelView)) * ((hit - sphere.xyz) / sphere.w));
+    float diffuse = max(dot(normal, lightPos1), 0.0) + max(dot(normal, lightPos2), 0.0);
+    fragColor = color;
+    fragColor.rgb *= min(diffuse * 0.6 + 0.4, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#version 460
+
+layout(std140) uniform Global {
+    mat4 projection;
+    mat4 modelView;
+    mat4 inverseProjection;
+    mat4 inverseModelView;
+    vec2 screenResolution;
+    float tickDelta;
+    // walls at +-arenaHalf on every axis
+    float arenaHalf;
+};
+
+// one per food, the color is an index into palette
+layout(location = 2) in vec3 instancePos;
+layout(location = 3) in float instanceRadius;
+layout(location = 4) in uint instanceColor;
+
+// by FoodColor
+const vec4 palette[2] = vec4[](
+    vec4(1.0, 0.0, 0.0, 1.0),
+    vec4(0.0, 0.0, 0.0, 0.0)
+);
+
+const vec2 corners[6] = vec2[](
+    vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0),
+    vec2(-1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0)
+);
+
+out vec3 worldPos;
+flat out vec4 sphere;
+flat out vec4 color;
+
+void main() {
+    vec3 eye = inverseModelView[3].xyz;
+    vec3 toCenter = instancePos - eye;
+    float distance = length(toCenter);
+    vec3 forward = toCenter / distance;
+    vec3 right = normalize(cross(forward, abs(forward.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0)));
+    vec3 up = cross(right, forward);
+
+    // a quad facing the eye right in front of the sphere, just big enough for every view ray that hits it to cross it
+    float radius = instanceRadius;
+    float front = max(distance - radius, 0.0);
+    float halfSize = front * radius / sqrt(max(distance * distance - radius * radius, 1e-6));
+    vec2 corner = corners[gl_VertexID];
+    worldPos = eye + forward * front + (right * corner.x + up * corner.y) * halfSize;
+
+    gl_Position = projection * modelView * vec4(worldPos, 1.0);
+    sphere = vec4(instancePos, radius);
+    color = palette[instanceColor];
+}
\ No newline at end of file
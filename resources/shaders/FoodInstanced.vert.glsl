@@ -0,0 +1,36 @@
+#version 460
+
+layout(std140) uniform Global {
+    mat4 projection;
+    mat4 modelView;
+    mat4 inverseProjection;
+    mat4 inverseModelView;
+    vec2 screenResolution;
+    float tickDelta;
+    // walls at +-arenaHalf on every axis
+    float arenaHalf;
+};
+
+// one of the subdivided icosahedrons, the same for every food, normalized shorts and 10:10:10:2
+layout(location = 0) in vec4 vertPos;
+layout(location = 1) in vec4 vertNormal;
+// one per food, the color is an index into palette
+layout(location = 2) in vec3 instancePos;
+layout(location = 3) in float instanceRadius;
+layout(location = 4) in uint instanceColor;
+
+// by FoodColor
+const vec4 palette[2] = vec4[](
+    vec4(1.0, 0.0, 0.0, 1.0),
+    vec4(0.0, 0.0, 0.0, 0.0)
+);
+
+out vec3 normal;
+out vec4 color;
+
+void main() {
+    vec3 worldPos = vertPos.xyz * instanceRadius + instancePos;
+    gl_Position = projection * modelView * vec4(worldPos, 1.0);
+	normal = normalize(transpose(mat3(inverseModelView)) * vertNormal.xyz);
+	color = palette[instanceColor];
+}
\ No newline at end of file
@@ -8,8 +8,9 @@ out vec4 fragColor;
 const vec3 lightPos1 = vec3(0.16169041, 0.80845207, -0.5659165);
 const vec3 lightPos2 = vec3(-0.16169041, 0.80845207, 0.5659165);
 
+// foods interpolate their normals, which shortens them
 float calcDiffuse(vec3 lightPos) {
-    return max(dot(normal, lightPos), 0.0);
+    return max(dot(normalize(normal), lightPos), 0.0);
 }
 
 void main() {
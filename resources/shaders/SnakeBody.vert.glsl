@@ -0,0 +1,63 @@
+#version 460
+
+layout(std140) uniform Global {
+    mat4 projection;
+    mat4 modelView;
+    mat4 inverseProjection;
+    mat4 inverseModelView;
+    vec2 screenResolution;
+    float tickDelta;
+    // walls at +-arenaHalf on every axis
+    float arenaHalf;
+};
+
+// every snake's points back to back, w is the color of the segment to the next point or negative after a snake's last one
+layout(std430, binding = 1) readonly buffer SnakePoints {
+    vec4 points[];
+};
+// first points of the segments SnakeCull.comp found in view
+layout(std430, binding = 2) readonly buffer VisibleSegments {
+    uint visible[];
+};
+
+layout(location = 1) uniform float sideLength;
+
+// by SnakeColor
+const vec4 palette[2] = vec4[](
+    vec4(0.1, 0.8, 0.1, 1.0),
+    vec4(0.1, 0.3, 0.9, 1.0)
+);
+
+// one instance per visible segment, an axis aligned box around both of its points made of 36 vertices, two triangles a face
+const vec3 corners[8] = vec3[](
+    vec3(0.0, 0.0, 0.0), vec3(1.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0), vec3(1.0, 1.0, 0.0),
+    vec3(0.0, 0.0, 1.0), vec3(1.0, 0.0, 1.0), vec3(0.0, 1.0, 1.0), vec3(1.0, 1.0, 1.0)
+);
+const int faceCorners[36] = int[](
+    0, 3, 1, 0, 2, 3,
+    1, 7, 5, 1, 3, 7,
+    2, 7, 3, 2, 6, 7,
+    0, 1, 5, 0, 5, 4,
+    0, 4, 6, 0, 6, 2,
+    4, 5, 7, 4, 7, 6
+);
+const vec3 faceNormals[6] = vec3[](
+    vec3(0.0, 0.0, -1.0), vec3(1.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0),
+    vec3(0.0, -1.0, 0.0), vec3(-1.0, 0.0, 0.0), vec3(0.0, 0.0, 1.0)
+);
+
+out vec3 normal;
+out vec4 color;
+
+void main() {
+    uint first = visible[gl_InstanceID];
+    vec4 a = points[first];
+    vec3 b = points[first + 1u].xyz;
+    vec3 low = min(a.xyz, b) - sideLength * 0.5;
+    vec3 high = max(a.xyz, b) + sideLength * 0.5;
+
+    vec3 worldPos = mix(low, high, corners[faceCorners[gl_VertexID]]);
+    gl_Position = projection * modelView * vec4(worldPos, 1.0);
+	normal = normalize(transpose(mat3(inverseModelView)) * faceNormals[gl_VertexID / 6]);
+	color = palette[uint(a.w)];
+}
\ No newline at end of file
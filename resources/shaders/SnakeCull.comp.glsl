@@ -0,0 +1,61 @@
+#version 460
+
+layout(local_size_x = 64) in;
+
+layout(std140) uniform Global {
+    mat4 projection;
+    mat4 modelView;
+    mat4 inverseProjection;
+    mat4 inverseModelView;
+    vec2 screenResolution;
+    float tickDelta;
+    // walls at +-arenaHalf on every axis
+    float arenaHalf;
+};
+
+// every snake's points back to back, w is the color of the segment to the next point or negative after a snake's last one
+layout(std430, binding = 1) readonly buffer SnakePoints {
+    vec4 points[];
+};
+// first points of the segments in view, packed to the front
+layout(std430, binding = 2) writeonly buffer VisibleSegments {
+    uint visible[];
+};
+// a DrawArraysIndirectCommand, instanceCount starts at 0
+layout(std430, binding = 3) buffer DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint first;
+    uint baseInstance;
+};
+
+layout(location = 0) uniform uint pointCount;
+layout(location = 1) uniform float sideLength;
+
+// false if the box is entirely outside one of the frustum's planes, which come straight out of the clip matrix's rows
+bool inFrustum(vec3 center, vec3 extent) {
+    mat4 rows = transpose(projection * modelView);
+    vec4 planes[6] = vec4[](
+        rows[3] + rows[0], rows[3] - rows[0],
+        rows[3] + rows[1], rows[3] - rows[1],
+        rows[3] + rows[2], rows[3] - rows[2]
+    );
+    for (int i = 0; i < 6; ++i) {
+        if (dot(planes[i].xyz, center) + planes[i].w < -dot(abs(planes[i].xyz), extent)) return false;
+    }
+    return true;
+}
+
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+    if (i + 1u >= pointCount) return;
+
+    vec4 a = points[i];
+    if (a.w < 0.0) return;
+    vec3 b = points[i + 1u].xyz;
+    vec3 low = min(a.xyz, b) - sideLength * 0.5;
+    vec3 high = max(a.xyz, b) + sideLength * 0.5;
+    if (!inFrustum((low + high) * 0.5, (high - low) * 0.5)) return;
+
+    visible[atomicAdd(instanceCount, 1u)] = i;
+}
\ No newline at end of file
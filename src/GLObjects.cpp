@@ -1,8 +1,12 @@
 #include <iostream>
+#include <span>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
-#include <sstream>
 #include <string>
+#include <filesystem>
 #include "GLObjects.hpp"
+#include "game/MappedFile.hpp"
 
 using namespace OpenGL;
 
@@ -196,6 +200,7 @@ unsigned int getSize(GLenum type) {
 			break;
 		case GL_SHORT:
 		case GL_UNSIGNED_SHORT:
+		case GL_HALF_FLOAT:
 			result = 2;
 			break;
 		case GL_INT:
@@ -210,15 +215,21 @@ unsigned int getSize(GLenum type) {
 	return result;
 }
 
+// bytes an attribute of size components takes, the packed formats hold all of theirs in 4
+unsigned int getSize(GLint size, GLenum type) {
+	if (type == GL_INT_2_10_10_10_REV || type == GL_UNSIGNED_INT_2_10_10_10_REV) return 4;
+	return size * getSize(type);
+}
+
 VertexAttribute::Builder& VertexAttribute::Builder::addInt(GLuint index, GLint size, GLenum type) {
 	entries.push_back((VertexAttribute::Entry*) new VertexAttribute::Entry::Int(index, size, type, this->offset));
-	offset += size * getSize(type);
+	offset += getSize(size, type);
 	return *this;
 }
 
 VertexAttribute::Builder& VertexAttribute::Builder::addFloat(GLuint index, GLint size, GLenum type, GLboolean normalized) {
 	entries.push_back((VertexAttribute::Entry*) new VertexAttribute::Entry::Float(index, size, type, this->offset, normalized));
-	offset += size * getSize(type);
+	offset += getSize(size, type);
 	return *this;
 }
 
@@ -231,62 +242,179 @@ VertexAttribute& VertexAttribute::Builder::build() {
 	return *new VertexAttribute(entries, stride, divisor);
 }
 
-GLint createShader(const std::string path, GLenum shaderType) {
-	std::ifstream t(path);
-	std::stringstream buffer;
-	buffer << t.rdbuf();
+std::string OpenGL::ShaderProgram::cacheDirectory = "shader-cache";
+OpenGL::ShaderProgram::CacheStats OpenGL::ShaderProgram::cacheStats;
+static bool parallelCompile = false;
 
-	std::string codeSrc = buffer.str();
-	const GLchar* codeSrcCStr = codeSrc.c_str();
+void OpenGL::ShaderProgram::enableParallelCompile() {
+	// as many compiler threads as the driver likes
+	if (GLEW_KHR_parallel_shader_compile) {
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+		parallelCompile = true;
+	}
+	else if (GLEW_ARB_parallel_shader_compile) {
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+		parallelCompile = true;
+	}
+}
 
-	GLint id = glCreateShader(shaderType);
-	glShaderSource(id, 1, &codeSrcCStr, NULL);
-	glCompileShader(id);
+static std::string readSource(const std::string& path) {
+	MappedFile file;
+	if (!file.open(path)) {
+		std::cout << "Can't read shader " << path << std::endl;
+		return {};
+	}
+	std::span<const uint8_t> bytes = file.bytes();
+	return std::string((const char*) bytes.data(), bytes.size());
+}
 
+static uint64_t fnv1a(uint64_t hash, const void* data, size_t size) {
+	for (size_t i = 0; i < size; ++i) {
+		hash = (hash ^ ((const uint8_t*) data)[i]) * 0x100000001b3ull;
+	}
+	return hash;
+}
+
+// a binary is only good for the driver that made it, so the driver is part of the key along with every stage
+static uint64_t programKey(const std::vector<std::pair<GLenum, std::string>>& stages) {
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+		const char* text = (const char*) glGetString(name);
+		if (text) hash = fnv1a(hash, text, std::strlen(text) + 1);
+	}
+	for (const auto& [type, source] : stages) {
+		hash = fnv1a(hash, &type, sizeof(type));
+		hash = fnv1a(hash, source.c_str(), source.size() + 1);
+	}
+	return hash;
+}
+
+static void printShaderLog(GLuint shader) {
 	GLint compiled = 0;
-	glGetShaderiv(id, GL_COMPILE_STATUS, &compiled);
-	if (compiled == GL_FALSE) {
-		GLint logLength;
-		glGetShaderiv(id, GL_INFO_LOG_LENGTH, &logLength);
-
-		if (logLength > 0) {
-			std::vector<GLchar> infoLog(logLength);
-			glGetShaderInfoLog(id, logLength, &logLength, &infoLog[0]);
-			std::cout << &infoLog[0] << std::endl;
-		}
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+	if (compiled == GL_TRUE) return;
+
+	GLint logLength;
+	glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+	if (logLength > 0) {
+		std::vector<GLchar> infoLog(logLength);
+		glGetShaderInfoLog(shader, logLength, &logLength, &infoLog[0]);
+		std::cout << &infoLog[0] << std::endl;
 	}
+}
 
-	return id;
+static void printProgramLog(GLuint program) {
+	GLint logLength;
+	glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+	if (logLength > 0) {
+		std::vector<GLchar> infoLog(logLength);
+		glGetProgramInfoLog(program, logLength, &logLength, &infoLog[0]);
+		std::cout << &infoLog[0] << std::endl;
+	}
 }
 
-OpenGL::ShaderProgram::ShaderProgram(const std::string vertex, const std::string fragment) {
+void OpenGL::ShaderProgram::build(std::initializer_list<std::pair<std::string, GLenum>> stages) {
 	this->id = glCreateProgram();
-	int vert = createShader(vertex, GL_VERTEX_SHADER);
-	int frag = createShader(fragment, GL_FRAGMENT_SHADER);
 
-	glAttachShader(this->id, vert);
-	glAttachShader(this->id, frag);
+	std::vector<std::pair<GLenum, std::string>> sources;
+	for (const auto& [path, type] : stages) {
+		sources.push_back({ type, readSource(path) });
+	}
 
+	// drivers without a single binary format can't cache
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	if (!cacheDirectory.empty() && formats > 0) {
+		char name[32];
+		std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long) programKey(sources));
+		this->cachePath = cacheDirectory + "/" + name;
+		if (loadBinary()) {
+			cacheStats.hits++;
+			return;
+		}
+		glProgramParameteri(this->id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	cacheStats.misses++;
+
+	for (const auto& [type, source] : sources) {
+		GLuint shader = glCreateShader(type);
+		const GLchar* text = source.c_str();
+		glShaderSource(shader, 1, &text, NULL);
+		glCompileShader(shader);
+		glAttachShader(this->id, shader);
+		this->shaders.push_back(shader);
+	}
+	// nothing asks how it went until ready(), with parallel compile this returns before the driver is done
 	glLinkProgram(this->id);
+}
+
+bool OpenGL::ShaderProgram::loadBinary() {
+	MappedFile file;
+	if (!file.open(this->cachePath)) return false;
 
+	std::span<const uint8_t> bytes = file.bytes();
+	if (bytes.size() <= sizeof(GLenum)) return false;
+	GLenum format;
+	std::memcpy(&format, bytes.data(), sizeof(format));
+	glProgramBinary(this->id, format, bytes.data() + sizeof(format), (GLsizei) (bytes.size() - sizeof(format)));
+
+	// drivers turn down binaries they don't like any more, the program then links from source like a miss
 	GLint linked = 0;
 	glGetProgramiv(this->id, GL_LINK_STATUS, &linked);
-	if (linked == GL_FALSE) {
-		GLint logLength;
-		glGetProgramiv(this->id, GL_INFO_LOG_LENGTH, &logLength);
+	return linked == GL_TRUE;
+}
 
-		if (logLength > 0) {
-			std::vector<GLchar> infoLog(logLength);
-			glGetProgramInfoLog(this->id, logLength, &logLength, &infoLog[0]);
-			std::cout << &infoLog[0] << std::endl;
+void OpenGL::ShaderProgram::saveBinary() const {
+	GLint length = 0;
+	glGetProgramiv(this->id, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+
+	// the format first, then the binary
+	std::vector<char> file(sizeof(GLenum) + length);
+	GLenum format = 0;
+	glGetProgramBinary(this->id, length, &length, &format, file.data() + sizeof(GLenum));
+	std::memcpy(file.data(), &format, sizeof(format));
+
+	std::error_code error;
+	std::filesystem::create_directories(cacheDirectory, error);
+	std::ofstream out(this->cachePath, std::ios::binary | std::ios::trunc);
+	out.write(file.data(), (std::streamsize) (sizeof(GLenum) + length));
+	if (!out.good()) std::cout << "Can't cache program in " << this->cachePath << std::endl;
+}
+
+OpenGL::ShaderProgram::ShaderProgram(const std::string vertex, const std::string fragment) {
+	build({ { vertex, GL_VERTEX_SHADER }, { fragment, GL_FRAGMENT_SHADER } });
+}
+
+OpenGL::ShaderProgram::ShaderProgram(const std::string compute) {
+	build({ { compute, GL_COMPUTE_SHADER } });
+}
+
+bool OpenGL::ShaderProgram::ready() {
+	if (this->shaders.empty()) return true;
+	if (parallelCompile) {
+		GLint done = GL_FALSE;
+		glGetProgramiv(this->id, GL_COMPLETION_STATUS_KHR, &done);
+		if (done == GL_FALSE) return false;
+	}
+
+	GLint linked = 0;
+	glGetProgramiv(this->id, GL_LINK_STATUS, &linked);
+	if (linked == GL_FALSE) {
+		for (GLuint shader : this->shaders) {
+			printShaderLog(shader);
 		}
+		printProgramLog(this->id);
 	}
 
-	glDetachShader(this->id, vert);
-	glDetachShader(this->id, frag);
+	for (GLuint shader : this->shaders) {
+		glDetachShader(this->id, shader);
+		glDeleteShader(shader);
+	}
+	this->shaders.clear();
 
-	glDeleteShader(vert);
-	glDeleteShader(frag);
+	if (linked == GL_TRUE && !this->cachePath.empty()) saveBinary();
+	return true;
 }
 
 void OpenGL::ShaderProgram::destroy() const {
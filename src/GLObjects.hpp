@@ -128,13 +128,41 @@ namespace OpenGL {
 		class Int;
 	};
 
+	// linked programs are cached as binaries keyed by their sources and the driver, so warm starts skip compiling,
+	// misses compile while the caller gets on with other things if the driver can, ready() says when they're done
 	class ShaderProgram : public IGLBinding {
 	private:
 		std::unordered_map<std::string, GLuint> bindings;
+		// still compiling and linking, ready() checks and deletes them
+		std::vector<GLuint> shaders;
+		// empty if the program isn't cached
+		std::string cachePath;
+
+		void build(std::initializer_list<std::pair<std::string, GLenum>> stages);
+		bool loadBinary();
+		void saveBinary() const;
+
 	public:
+		struct CacheStats {
+			size_t hits = 0;
+			size_t misses = 0;
+		};
+
+		// where the binaries go, relative to the working directory like the shaders, empty turns caching off
+		static std::string cacheDirectory;
+		static CacheStats cacheStats;
+		// lets the driver compile on its own threads where GL_KHR_parallel_shader_compile is there, once a context is current
+		static void enableParallelCompile();
+
 		ShaderProgram(const std::string vertex, const std::string fragment);
+		// a compute program
+		explicit ShaderProgram(const std::string compute);
 		~ShaderProgram();
 
+		// true once linked, false while the driver is still at it, never waits if it compiles in parallel
+		// the first true prints what failed and caches the binary
+		bool ready();
+
 		void destroy() const override;
 		void bind0(const GLuint id) const override;
 
@@ -0,0 +1,77 @@
+#include "GpuProfiler.hpp"
+#include "Profiler.hpp"
+
+GpuProfiler::~GpuProfiler() {
+	for (auto& frame : frames) {
+		for (auto& span : frame.spans) {
+			glDeleteQueries(1, &span.begin);
+			glDeleteQueries(1, &span.end);
+		}
+	}
+}
+
+void GpuProfiler::beginFrame() {
+	Profiler& profiler = Profiler::instance();
+	current = nullptr;
+	if (!profiler.enabled()) return;
+
+	uint32_t number = profiler.frame();
+	Frame& frame = frames[number % latency];
+
+	// whatever this slot timed latency frames ago, if the gpu got that far
+	for (size_t i = 0; i < frame.used; ++i) {
+		const Span& span = frame.spans[i];
+		GLint ready = 0;
+		glGetQueryObjectiv(span.end, GL_QUERY_RESULT_AVAILABLE, &ready);
+		if (!ready) continue;
+
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(span.begin, GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(span.end, GL_QUERY_RESULT, &end);
+		profiler.recordGpu(span.name, (uint64_t) ((int64_t) begin - frame.offset), (uint64_t) ((int64_t) end - frame.offset),
+			frame.frame);
+	}
+
+	frame.frame = number;
+	frame.used = 0;
+	open.clear();
+	current = &frame;
+
+	// the gpu's clock has its own zero, line it up with the cpu's once a frame
+	GLint64 gpuNow = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+	frame.offset = (int64_t) gpuNow - (int64_t) Profiler::now();
+}
+
+void GpuProfiler::begin(const char* name) {
+	if (!current) return;
+
+	Frame& frame = *current;
+	if (frame.used == frame.spans.size()) {
+		Span span{ name, 0, 0 };
+		glGenQueries(1, &span.begin);
+		glGenQueries(1, &span.end);
+		frame.spans.push_back(span);
+	}
+
+	Span& span = frame.spans[frame.used];
+	span.name = name;
+	glQueryCounter(span.begin, GL_TIMESTAMP);
+	open.push_back(frame.used++);
+}
+
+void GpuProfiler::end() {
+	if (!current || open.empty()) return;
+
+	glQueryCounter(current->spans[open.back()].end, GL_TIMESTAMP);
+	open.pop_back();
+}
+
+GpuProfileScope::GpuProfileScope(GpuProfiler& profiler, const char* name) :
+	profiler(Profiler::instance().enabled() ? &profiler : nullptr) {
+	if (this->profiler) this->profiler->begin(name);
+}
+
+GpuProfileScope::~GpuProfileScope() {
+	if (profiler) profiler->end();
+}
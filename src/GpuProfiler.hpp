@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <GL/glew.h>
+
+// GL_TIMESTAMP queries around draw groups, handed to the Profiler once the gpu is done with them
+// a frame's queries are only read back latency frames later and skipped if they still aren't ready, so reading
+// never stalls the pipeline
+class GpuProfiler {
+public:
+	static constexpr int latency = 4;
+
+private:
+	struct Span {
+		const char* name;
+		GLuint begin;
+		GLuint end;
+	};
+
+	struct Frame {
+		uint32_t frame = 0;
+		// gpu clock minus Profiler::now() when the frame started
+		int64_t offset = 0;
+		std::vector<Span> spans;
+		size_t used = 0;
+	};
+
+	std::array<Frame, latency> frames;
+	Frame* current = nullptr;
+	// indices of the spans begun but not ended, innermost last
+	std::vector<size_t> open;
+
+public:
+	GpuProfiler() = default;
+	~GpuProfiler();
+
+	GpuProfiler(const GpuProfiler&) = delete;
+	GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+	// reads back the frame that used this slot latency frames ago and starts the profiler's current frame
+	void beginFrame();
+
+	void begin(const char* name);
+	void end();
+};
+
+// a draw group timed on the gpu, does nothing while the profiler is off
+class GpuProfileScope {
+private:
+	GpuProfiler* profiler;
+
+public:
+	GpuProfileScope(GpuProfiler& profiler, const char* name);
+	~GpuProfileScope();
+
+	GpuProfileScope(const GpuProfileScope&) = delete;
+	GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+};
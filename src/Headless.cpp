@@ -0,0 +1,271 @@
+// Runs the simulation with no window for a fixed amount of simulated time and reports how fast it ticked.
+// usage: wacky-headless [--seconds 60] [--dt 0.016667] [--foods 1000] [--seed 42] [--turn 0.5] [--snakes 1] [--threads 0]
+//                       [--half 64] [--stream 128]
+//                       [--record file] [--save file] [--load file] [--trace file]
+//        wacky-headless --replay file [--seek tick] [--threads 0]
+
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <stdexcept>
+
+#include "game/Game.hpp"
+#include "game/Random.hpp"
+#include "game/Replay.hpp"
+#include "game/Snapshot.hpp"
+#include "Profiler.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+	double seconds = 60.0;
+	double dt = 1.0 / 60.0;
+	// foods in the whole arena, only the chunks near snakes get theirs
+	uint64_t foods = 1000;
+	uint64_t seed = 42;
+	// simulated seconds between random turns, 0 flies straight
+	double turnEvery = 0.5;
+	size_t snakes = 1;
+	// workers for the move phase, 0 uses every hardware thread
+	unsigned threads = 0;
+	// walls at +-half, chunks within stream of a snake's chunk are loaded
+	int half = World::defaultHalf;
+	float stream = World::defaultStreamRadius;
+	std::string record;
+	// game image written right after generation, or read instead of generating
+	std::string save;
+	std::string load;
+	std::string replay;
+	// chrome trace of the last ticks, every tick counts as a frame
+	std::string trace;
+	// tick to jump to before playing the replay
+	uint64_t seek = 0;
+};
+
+static bool parseOptions(int argc, char** argv, Options& options) {
+	for (int i = 1; i < argc; ++i) {
+		const char* arg = argv[i];
+		if (i + 1 >= argc) {
+			std::fprintf(stderr, "missing value for %s\n", arg);
+			return false;
+		}
+		const char* value = argv[++i];
+
+		try {
+			if (std::strcmp(arg, "--seconds") == 0) options.seconds = std::stod(value);
+			else if (std::strcmp(arg, "--dt") == 0) options.dt = std::stod(value);
+			else if (std::strcmp(arg, "--foods") == 0) options.foods = std::stoull(value);
+			else if (std::strcmp(arg, "--seed") == 0) options.seed = std::stoull(value);
+			else if (std::strcmp(arg, "--turn") == 0) options.turnEvery = std::stod(value);
+			else if (std::strcmp(arg, "--snakes") == 0) options.snakes = std::stoull(value);
+			else if (std::strcmp(arg, "--threads") == 0) options.threads = (unsigned) std::stoul(value);
+			else if (std::strcmp(arg, "--half") == 0) options.half = std::stoi(value);
+			else if (std::strcmp(arg, "--stream") == 0) options.stream = std::stof(value);
+			else if (std::strcmp(arg, "--record") == 0) options.record = value;
+			else if (std::strcmp(arg, "--save") == 0) options.save = value;
+			else if (std::strcmp(arg, "--load") == 0) options.load = value;
+			else if (std::strcmp(arg, "--replay") == 0) options.replay = value;
+			else if (std::strcmp(arg, "--seek") == 0) options.seek = std::stoull(value);
+			else if (std::strcmp(arg, "--trace") == 0) options.trace = value;
+			else {
+				std::fprintf(stderr, "unknown option %s\n", arg);
+				return false;
+			}
+		} catch (const std::exception&) {
+			std::fprintf(stderr, "bad value for %s: %s\n", arg, value);
+			return false;
+		}
+	}
+
+	if (options.dt <= 0.0 || options.seconds < 0.0 || options.snakes == 0) {
+		std::fprintf(stderr, "--dt and --snakes must be positive and --seconds not negative\n");
+		return false;
+	}
+	return true;
+}
+
+// one of the six axis directions, the same moves a player can make
+static glm::vec2 randomRotation(CounterRng& rng) {
+	float yaw = (float) rng.below(4) * 90.0f;
+	float pitch = ((float) rng.below(3) - 1.0f) * 90.0f;
+	return glm::vec2(pitch == 0.0f ? yaw : 0.0f, pitch);
+}
+
+struct Spawn {
+	glm::vec3 head;
+	glm::vec2 rotation;
+};
+
+// somewhere well inside the walls, facing a random way
+static Spawn randomSpawn(CounterRng& rng, int half) {
+	int reach = std::max(half - 24, 0);
+	auto coord = [&] { return (float) rng.below(2 * reach + 1) - (float) reach; };
+	glm::vec3 head(coord(), coord(), coord());
+	return { head, randomRotation(rng) };
+}
+
+// fnv-1a of the whole snapshot, equal hashes mean the runs ended in the same state
+static uint64_t stateHash(const Game& game) {
+	ByteWriter out;
+	writeGame(out, game);
+
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (uint8_t byte : out.bytes) {
+		hash = (hash ^ byte) * 0x100000001b3ull;
+	}
+	return hash;
+}
+
+static int replay(const Options& options) {
+	ReplayReader reader;
+	if (!reader.open(options.replay)) {
+		std::fprintf(stderr, "can't read replay %s\n", options.replay.c_str());
+		return 1;
+	}
+
+	auto game = std::make_unique<Game>();
+	game->threads = options.threads;
+
+	auto seekStart = Clock::now();
+	if (!reader.seek(*game, options.seek)) {
+		std::fprintf(stderr, "replay ends before tick %llu\n", (unsigned long long) options.seek);
+		return 1;
+	}
+	double seekWall = std::chrono::duration<double>(Clock::now() - seekStart).count();
+	uint64_t from = game->ticks;
+
+	auto start = Clock::now();
+	reader.play(*game);
+	double wall = std::chrono::duration<double>(Clock::now() - start).count();
+	uint64_t ticks = game->ticks - from;
+
+	size_t eaten = 0;
+	for (const auto& snake : game->snakes) {
+		eaten += snake.foodsEaten;
+	}
+
+	std::printf("replay %s, %s, seed %llu, %zu snakes\n", options.replay.c_str(), reader.hasIndex() ? "indexed" : "no index",
+		(unsigned long long) reader.seed, game->snakes.size());
+	std::printf("seek to %llu in %.3f ms\n", (unsigned long long) from, seekWall * 1000.0);
+	std::printf("%llu ticks in %.3f s, %.0f ticks/s\n", (unsigned long long) ticks, wall, wall > 0.0 ? ticks / wall : 0.0);
+	std::printf("ended at tick %llu, %zu foods held, state %016llx\n", (unsigned long long) game->ticks, eaten,
+		(unsigned long long) stateHash(*game));
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	if (!parseOptions(argc, argv, options)) return 1;
+	if (!options.replay.empty()) return replay(options);
+
+	// World holds a 32^3 grid, keep it off the stack
+	auto game = std::make_unique<Game>();
+	game->threads = options.threads;
+	// replays tick at the clock's rate
+	game->clock.step = options.dt;
+
+	// spawns and turns come from their own stream so the run only depends on the options
+	CounterRng ai(options.seed, 2);
+	auto setupStart = Clock::now();
+	if (!options.load.empty()) {
+		if (!loadGameImage(options.load, *game)) {
+			std::fprintf(stderr, "can't load game image %s\n", options.load.c_str());
+			return 1;
+		}
+		game->threads = options.threads;
+		options.dt = game->clock.step;
+	} else {
+		game->world.resize(options.half);
+		game->world.streamRadius = options.stream;
+		for (size_t i = 1; i < options.snakes; ++i) {
+			Spawn spawn = randomSpawn(ai, game->world.half);
+			game->addSnake(Snake(spawn.head, spawn.rotation));
+		}
+		game->generate(options.seed, options.foods);
+	}
+	double setupWall = std::chrono::duration<double>(Clock::now() - setupStart).count();
+	size_t placed = game->world.foodCount();
+	game->state = State::Playing;
+
+	if (!options.save.empty() && !saveGameImage(options.save, *game)) {
+		std::fprintf(stderr, "can't save game image %s\n", options.save.c_str());
+		return 1;
+	}
+
+	ReplayWriter recorder;
+	if (!options.record.empty() && !recorder.open(options.record, *game)) {
+		std::fprintf(stderr, "can't write replay %s\n", options.record.c_str());
+		return 1;
+	}
+
+	Profiler& profiler = Profiler::instance();
+	if (!options.trace.empty()) {
+		profiler.nameThread("main");
+		profiler.setEnabled(true);
+	}
+
+	std::vector<double> sinceTurn(game->snakes.size(), 0.0);
+	long long ticks = (long long) (options.seconds / options.dt);
+	size_t eaten = 0;
+	long long deaths = 0;
+
+	auto start = Clock::now();
+	for (long long i = 0; i < ticks; ++i) {
+		for (size_t s = 0; s < game->snakes.size(); ++s) {
+			sinceTurn[s] += options.dt;
+			if (options.turnEvery > 0.0 && sinceTurn[s] >= options.turnEvery) {
+				sinceTurn[s] = 0.0;
+				glm::vec2 rotation = randomRotation(ai);
+				recorder.turn(*game, s, rotation);
+				game->snakes[s].setRotation(rotation);
+			}
+		}
+
+		game->fixedTick();
+
+		for (size_t s = 0; s < game->snakes.size(); ++s) {
+			if (game->lost[s] == LoseCode::None) continue;
+
+			eaten += game->snakes[s].foodsEaten;
+			deaths++;
+			Spawn spawn = s == 0 ? Spawn{ glm::vec3(0.0f), glm::vec2(0.0f) } : randomSpawn(ai, game->world.half);
+			recorder.spawn(*game, s, spawn.head, spawn.rotation, 20.0f);
+			game->respawn(s, Snake(spawn.head, spawn.rotation));
+		}
+		if (game->state != State::Playing) {
+			recorder.setState(*game, State::Playing);
+			game->state = State::Playing;
+		}
+		recorder.capture(*game);
+		profiler.endFrame();
+	}
+	recorder.close();
+	double wall = std::chrono::duration<double>(Clock::now() - start).count();
+	for (const auto& snake : game->snakes) {
+		eaten += snake.foodsEaten;
+	}
+
+	std::printf("seed %llu, %zu snakes, %zu foods loaded, dt %.6f s\n", (unsigned long long) options.seed, game->snakes.size(), placed, options.dt);
+	std::printf("%s in %.3f ms\n", options.load.empty() ? "generated" : "loaded", setupWall * 1000.0);
+	std::printf("%lld ticks (%.1f simulated s) in %.3f s\n", ticks, ticks * options.dt, wall);
+	std::printf("%.0f ticks/s, %.1fx real time\n", wall > 0.0 ? ticks / wall : 0.0, wall > 0.0 ? ticks * options.dt / wall : 0.0);
+	std::printf("%zu foods eaten, %lld deaths\n", eaten, deaths);
+	std::printf("arena %d^3, %zu chunks loaded, %zu stored, %zu object slots\n", 2 * game->world.half, game->world.chunks.size(),
+		game->world.stored.size(), game->world.objects.size());
+	if (!options.trace.empty()) {
+		std::printf("%s\n", profiler.summary(Profiler::historyFrames, 0).c_str());
+		if (!profiler.writeTrace(options.trace, Profiler::historyFrames)) {
+			std::fprintf(stderr, "can't write trace %s\n", options.trace.c_str());
+			return 1;
+		}
+		std::printf("last %zu ticks traced to %s\n", Profiler::historyFrames, options.trace.c_str());
+	}
+	if (!options.record.empty()) {
+		std::printf("recorded to %s, ended at tick %llu, state %016llx\n", options.record.c_str(),
+			(unsigned long long) game->ticks, (unsigned long long) stateHash(*game));
+	}
+}
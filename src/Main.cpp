@@ -2,11 +2,17 @@
 
 #include <iostream>
 #include <string>
+#include <atomic>
+#include <optional>
 
 #include <gl/glew.h>
 #include <GLFW/glfw3.h>
 #include "RenderEngine.hpp"
+#include "Simulation.hpp"
 #include "game/Game.hpp"
+#include "game/Replay.hpp"
+#include "game/Snapshot.hpp"
+#include "Profiler.hpp"
 
 #include "Main.hpp"
 
@@ -24,13 +30,66 @@ void GLAPIENTRY messageCallback(GLenum source,
 }
 
 // game instance
+// foods in an arena of World::defaultHalf, bigger arenas get as many per volume
 constexpr int INITIAL_FOODS = 1000;
 Game game{};
+// ticks game on its own thread once the window is up, everything after that reaches the game through it
+Simulation simulation{ game };
 RenderEngine* renderEnginePtr;
+// set from the command line to replay a layout from a bug report, otherwise every round gets a new seed
+std::optional<uint64_t> fixedSeed;
+// --record writes everything the keys do to the game, play it back with wacky-headless --replay
+ReplayWriter recorder;
+// Ctrl+P writes this many frames of profile, the frame breakdown is logged every this many seconds
+constexpr size_t TRACE_FRAMES = 300;
+constexpr double PROFILE_LOG_INTERVAL = 10.0;
+// --arena starts every round from a game image, made from the first generated round if the file isn't there
+std::optional<std::string> arenaPath;
+
+void startGame() {
+	if (arenaPath) {
+		// the tick count carries on for replays, and images saved mid round still start with the wait
+		uint64_t ticks = game.ticks;
+		if (loadGameImage(*arenaPath, game)) {
+			game.ticks = ticks;
+			game.state = State::Waiting;
+			game.timeElapsed = 0.0;
+			std::cout << "Arena loaded from " << *arenaPath << std::endl;
+			return;
+		}
+	}
+
+	uint64_t seed = fixedSeed.value_or(World::randomSeed());
+	std::cout << "World seed: " << seed << std::endl;
+	double scale = (double) game.world.half / World::defaultHalf;
+	game.generate(seed, (uint64_t) (INITIAL_FOODS * scale * scale * scale));
+
+	if (arenaPath && !saveGameImage(*arenaPath, game)) {
+		std::cerr << "Can't save arena to " << *arenaPath << std::endl;
+	}
+}
+
+// set once the renderer has its programs, rounds wait in State::Waiting for it
+std::atomic<bool> rendererReady{ false };
+
+// simulation thread
+void startPlaying(Game& game) {
+	if (game.state != State::Waiting || !rendererReady.load()) return;
+	recorder.setState(game, State::Playing);
+	game.state = State::Playing;
+	game.timeElapsed = 0.0;
+}
 
 bool controlled = false;
 bool wireframe = false;
 
+void turnPlayer(glm::vec2 rotation) {
+	simulation.post([rotation](Game& game) {
+		recorder.turn(game, 0, rotation);
+		game.player().setRotation(rotation);
+	});
+}
+
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
 	if (key == GLFW_KEY_LEFT_CONTROL) {
 		if (action == GLFW_PRESS) {
@@ -47,23 +106,23 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
 		cameraRotation = glm::round(cameraRotation / 90.0f) * 90.0f;
 		switch (key) {
 			case GLFW_KEY_W:
-				game.player.setRotation(cameraRotation + glm::vec2(0.0f, 0.0f));
+				turnPlayer(cameraRotation + glm::vec2(0.0f, 0.0f));
 				break;
 			case GLFW_KEY_A:
-				game.player.setRotation(cameraRotation + glm::vec2(-90.0f, 0.0f));
+				turnPlayer(cameraRotation + glm::vec2(-90.0f, 0.0f));
 				break;
 			case GLFW_KEY_S:
-				game.player.setRotation(cameraRotation + glm::vec2(180.0f, 0.0f));
+				turnPlayer(cameraRotation + glm::vec2(180.0f, 0.0f));
 				break;
 			case GLFW_KEY_D:
-				game.player.setRotation(cameraRotation + glm::vec2(90.0f, 0.0f));
+				turnPlayer(cameraRotation + glm::vec2(90.0f, 0.0f));
 				break;
 
 			case GLFW_KEY_SPACE:
-				game.player.setRotation(glm::vec2(0.0f, 90.0f));
+				turnPlayer(glm::vec2(0.0f, 90.0f));
 				break;
 			case GLFW_KEY_LEFT_SHIFT:
-				game.player.setRotation(glm::vec2(0.0f, -90.0f));
+				turnPlayer(glm::vec2(0.0f, -90.0f));
 				break;
 
 			case GLFW_KEY_ESCAPE:
@@ -85,21 +144,42 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
 				break;
 			case GLFW_KEY_R: // restart
 				if (controlled) {
-					game.player = Snake();
-					game.state = State::Waiting;
-					game.timeElapsed = 0.0;
-					game.world.objects = {};
-					game.placeFood(INITIAL_FOODS);
+					simulation.post([](Game& game) {
+						game.respawn(0);
+						game.state = State::Waiting;
+						game.timeElapsed = 0.0;
+						game.clock.reset();
+						startGame();
+						// a new world, nothing short of the whole state describes it
+						recorder.keyframe(game, true);
+						startPlaying(game);
+					});
 				}
 				break;
 			case GLFW_KEY_F: // force end
 				if (controlled) {
-					game.state = State::Overing;
+					simulation.post([](Game& game) {
+						recorder.setState(game, State::Overing);
+						game.state = State::Overing;
+					});
 				}
 				break;
 			case GLFW_KEY_C: // force continue
 				if (controlled) {
-					game.state = State::Playing;
+					simulation.post([](Game& game) {
+						recorder.setState(game, State::Playing);
+						game.state = State::Playing;
+					});
+				}
+				break;
+			case GLFW_KEY_P: // dump the last frames for chrome://tracing
+				if (controlled) {
+					std::string path = "trace-" + std::to_string(Profiler::instance().frame()) + ".json";
+					if (Profiler::instance().writeTrace(path, TRACE_FRAMES)) {
+						std::cout << "Last " << TRACE_FRAMES << " frames traced to " << path << std::endl;
+					} else {
+						std::cerr << "Can't write trace " << path << std::endl;
+					}
 				}
 				break;
 			default:
@@ -108,9 +188,35 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
 	}
 }
 
-int main() {
+int main(int argc, char** argv) {
 	std::string title = "Wacky Snake";
 
+	// usage: wacky-snake [seed] [--record file] [--arena file] [--half 64] [--stream 128] [--no-vsync]
+	std::optional<std::string> recordPath;
+	int half = World::defaultHalf;
+	bool vsync = true;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--record" && i + 1 < argc) {
+			recordPath = argv[++i];
+		}
+		else if (arg == "--arena" && i + 1 < argc) {
+			arenaPath = argv[++i];
+		}
+		else if (arg == "--half" && i + 1 < argc) {
+			half = std::stoi(argv[++i]);
+		}
+		else if (arg == "--stream" && i + 1 < argc) {
+			game.world.streamRadius = std::stof(argv[++i]);
+		}
+		else if (arg == "--no-vsync") {
+			vsync = false;
+		}
+		else {
+			fixedSeed = std::stoull(arg);
+		}
+	}
+
 	glfwInit();
 
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
@@ -123,9 +229,10 @@ int main() {
 	glfwMakeContextCurrent(gameWindow.window);
 
 	glewInit();
+	OpenGL::ShaderProgram::enableParallelCompile();
 
-	// Double buffered V-Sync
-	glfwSwapInterval(1);
+	// Double buffered V-Sync, without it the mapped buffer's fences keep the cpu at most a few frames ahead
+	glfwSwapInterval(vsync ? 1 : 0);
 	glfwSetInputMode(gameWindow.window, GLFW_RAW_MOUSE_MOTION, GLFW_TRUE);
 	glfwSetInputMode(gameWindow.window, GLFW_CURSOR, GLFW_CURSOR_HIDDEN);
 	glfwPollEvents();
@@ -155,9 +262,21 @@ int main() {
 
 	double curTime = glfwGetTime();
 	double lastTickTime = curTime;
+	double lastProfileLog = curTime;
+
+	Profiler& profiler = Profiler::instance();
+	profiler.nameThread("main");
+	profiler.setEnabled(true);
 
 	// game initialization
-	game.placeFood(INITIAL_FOODS);
+	// rounded up to whole chunks, restarts keep it
+	game.world.resize(half);
+	startGame();
+	if (recordPath && !recorder.open(*recordPath, game)) {
+		std::cerr << "Can't record to " << *recordPath << std::endl;
+	}
+	simulation.afterTicks = [](Game& game) { recorder.capture(game); };
+	simulation.start();
 
 	while (!glfwWindowShouldClose(gameWindow.window)) {
 		glfwPollEvents();
@@ -168,10 +287,18 @@ int main() {
 		glfwSetCursorPos(gameWindow.window, center.x, center.y);
 		glfwGetCursorPos(gameWindow.window, &prevMousePos.x, &prevMousePos.y);
 
-		double time = glfwGetTime();
-		double dt = time - curTime;
-		curTime = time;
-		game.tick(dt);
+		curTime = glfwGetTime();
+		if (!rendererReady && renderEngine.ready()) {
+			rendererReady = true;
+			const auto& cache = OpenGL::ShaderProgram::cacheStats;
+			std::cout << "Ready in " << (int) (curTime * 1000.0) << " ms, " << cache.hits << " programs cached, " << cache.misses
+				<< " compiled" << std::endl;
+			simulation.post(startPlaying);
+		}
+		// the newest tick the simulation has published, it keeps ticking while this frame draws
+		simulation.take();
+		const RenderState& state = simulation.state();
+		float tickDelta = state.alpha(Profiler::now());
 
 		glfwGetWindowSize(gameWindow.window, &gameWindow.windowSize.x, &gameWindow.windowSize.y);
 
@@ -187,11 +314,14 @@ int main() {
 		glEnable(GL_CULL_FACE);
 		glCullFace(GL_BACK);
 
-		// Render goes here
+		// Render goes here, a blank screen while programs still compile
 		renderEngine.camera.updateProjection(gameWindow);
-		renderEngine.camera.updateModelView(game, mouseDelta);
-		renderEngine.setup(gameWindow, game, dt);
-		renderEngine.render(gameWindow, dt);
+		renderEngine.camera.updateModelView(state, mouseDelta, tickDelta);
+		if (rendererReady) {
+			renderEngine.setup(gameWindow, state, tickDelta);
+			simulation.markSynced(state.version);
+			renderEngine.render(gameWindow, tickDelta);
+		}
 
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
@@ -201,7 +331,19 @@ int main() {
 		}
 
 		glfwSwapBuffers(gameWindow.window);
+		profiler.endFrame();
+
+		if (curTime - lastProfileLog >= PROFILE_LOG_INTERVAL) {
+			lastProfileLog = curTime;
+			std::cout << profiler.summary() << std::endl;
+			const auto& stats = renderEngine.buffer.stats;
+			std::cout << "mapped buffer " << renderEngine.buffer.capacity() / 1024 << " KiB x" << PersistentMappedBuffer::framesInFlight
+				<< ", high water " << stats.highWater / 1024 << " KiB, " << stats.stalls << " stalls " << stats.stallNs / 1000000 << " ms, "
+				<< stats.overflows << " overflows, " << stats.grows << " grows" << std::endl;
+		}
 	}
 
+	simulation.stop();
+	recorder.close();
 	glfwDestroyWindow(gameWindow.window);
 }
\ No newline at end of file
@@ -0,0 +1,232 @@
+#include "Profiler.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <algorithm>
+
+void ProfileRing::push(const char* name, uint64_t start, uint64_t end, uint32_t frame) {
+	uint64_t index = head.load(std::memory_order_relaxed);
+	writing.store(index + 1, std::memory_order_relaxed);
+	// a reader that sees any of the stores below also sees writing move
+	std::atomic_thread_fence(std::memory_order_release);
+
+	Slot& slot = slots[index % capacity];
+	slot.name.store(name, std::memory_order_relaxed);
+	slot.start.store(start, std::memory_order_relaxed);
+	slot.end.store(end, std::memory_order_relaxed);
+	slot.frame.store(frame, std::memory_order_relaxed);
+
+	head.store(index + 1, std::memory_order_release);
+}
+
+size_t ProfileRing::drain(std::vector<ProfileEvent>& out) {
+	uint64_t end = head.load(std::memory_order_acquire);
+	uint64_t from = std::max(tail, end > capacity ? end - capacity : 0);
+	size_t lost = (size_t) (from - tail);
+
+	size_t first = out.size();
+	for (uint64_t i = from; i < end; ++i) {
+		const Slot& slot = slots[i % capacity];
+		out.push_back({
+			slot.name.load(std::memory_order_relaxed),
+			slot.start.load(std::memory_order_relaxed),
+			slot.end.load(std::memory_order_relaxed),
+			slot.frame.load(std::memory_order_relaxed),
+			track
+		});
+	}
+
+	// the owner kept pushing while these were read, anything it has started overwriting since is torn
+	std::atomic_thread_fence(std::memory_order_acquire);
+	uint64_t written = writing.load(std::memory_order_relaxed);
+	if (written > capacity && written - capacity > from) {
+		size_t torn = (size_t) std::min(written - capacity - from, end - from);
+		out.erase(out.begin() + (ptrdiff_t) first, out.begin() + (ptrdiff_t) (first + torn));
+		lost += torn;
+	}
+
+	tail = end;
+	return lost;
+}
+
+// a thread's ring for as long as the thread runs, threads that come and go, like the simulation's, hand theirs back
+class ProfileRingLease {
+public:
+	ProfileRing* ring = nullptr;
+
+	~ProfileRingLease() {
+		if (ring) Profiler::instance().giveBack(ring);
+	}
+};
+
+static thread_local ProfileRingLease lease;
+
+ProfileRing* Profiler::takeRing() {
+	std::lock_guard lock(ringsMutex);
+	if (!spareRings.empty()) {
+		ProfileRing* ring = spareRings.back();
+		spareRings.pop_back();
+		return ring;
+	}
+
+	uint32_t track = (uint32_t) rings.size();
+	rings.push_back(std::make_unique<ProfileRing>(track));
+	trackNames.push_back("thread " + std::to_string(track));
+	return rings.back().get();
+}
+
+void Profiler::giveBack(ProfileRing* ring) {
+	std::lock_guard lock(ringsMutex);
+	spareRings.push_back(ring);
+}
+
+ProfileRing& Profiler::threadRing() {
+	if (!lease.ring) lease.ring = takeRing();
+	return *lease.ring;
+}
+
+Profiler& Profiler::instance() {
+	static Profiler profiler;
+	return profiler;
+}
+
+uint64_t Profiler::now() {
+	using Clock = std::chrono::steady_clock;
+	static const Clock::time_point epoch = Clock::now();
+	return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - epoch).count();
+}
+
+void Profiler::setEnabled(bool enabled) {
+	if (enabled && !this->enabled()) {
+		// frames from before are cut short, start clean
+		history.clear();
+		history.push_back({ frame(), {} });
+		frameStart = now();
+	}
+	on.store(enabled, std::memory_order_relaxed);
+}
+
+void Profiler::nameThread(const std::string& name) {
+	ProfileRing& ring = threadRing();
+	std::lock_guard lock(ringsMutex);
+	trackNames[ring.track] = name;
+}
+
+void Profiler::recordGpu(const char* name, uint64_t start, uint64_t end, uint32_t frame) {
+	if (history.empty() || frame < history.front().frame || frame > history.back().frame) return;
+	history[frame - history.front().frame].events.push_back({ name, start, end, frame, gpuTrack });
+}
+
+void Profiler::endFrame() {
+	if (!enabled()) return;
+
+	uint64_t end = now();
+	record(frameName, frameStart, end);
+	frameStart = end;
+
+	drained.clear();
+	{
+		std::lock_guard lock(ringsMutex);
+		for (auto& ring : rings) {
+			lost += ring->drain(drained);
+		}
+	}
+	for (const auto& event : drained) {
+		// from before the profiler was last turned on
+		if (event.frame < history.front().frame || event.frame > history.back().frame) continue;
+		history[event.frame - history.front().frame].events.push_back(event);
+	}
+
+	uint32_t next = frame() + 1;
+	current.store(next, std::memory_order_relaxed);
+	history.push_back({ next, {} });
+	while (history.size() > historyFrames) history.pop_front();
+}
+
+std::string Profiler::summary(size_t frames, size_t skip) const {
+	// the frame still going isn't done either
+	skip += 1;
+	if (history.size() <= skip) return "no frames yet";
+
+	size_t last = history.size() - skip;
+	size_t first = last > frames ? last - frames : 0;
+	size_t count = last - first;
+
+	// per scope, how long it took in each frame, the frame itself then cpu scopes in the order they showed up, then gpu
+	struct Scope {
+		const char* name;
+		bool gpu;
+		std::vector<double> ms;
+	};
+	std::vector<Scope> scopes;
+	auto scopeOf = [&](const ProfileEvent& event) -> Scope& {
+		bool gpu = event.track == gpuTrack;
+		for (auto& scope : scopes) {
+			if (scope.name == event.name && scope.gpu == gpu) return scope;
+		}
+		scopes.push_back({ event.name, gpu, std::vector<double>(count, 0.0) });
+		return scopes.back();
+	};
+
+	for (size_t i = first; i < last; ++i) {
+		for (const auto& event : history[i].events) {
+			scopeOf(event).ms[i - first] += (double) (event.end - event.start) / 1e6;
+		}
+	}
+	std::stable_partition(scopes.begin(), scopes.end(), [](const Scope& scope) { return !scope.gpu; });
+	std::stable_partition(scopes.begin(), scopes.end(), [](const Scope& scope) { return !scope.gpu && scope.name == frameName; });
+
+	std::string out = std::to_string(count) + " frames, p50/p99 ms:";
+	for (auto& scope : scopes) {
+		std::sort(scope.ms.begin(), scope.ms.end());
+		double p50 = scope.ms[(count - 1) / 2];
+		double p99 = scope.ms[(count - 1) * 99 / 100];
+
+		char text[128];
+		std::snprintf(text, sizeof(text), " %s%s %.2f/%.2f", scope.gpu ? "gpu " : "", scope.name, p50, p99);
+		out += text;
+	}
+	if (lost > 0) out += ", " + std::to_string(lost) + " events lost";
+	return out;
+}
+
+static std::string escape(const std::string& text) {
+	std::string out;
+	for (char c : text) {
+		if (c == '"' || c == '\\') out += '\\';
+		out += c;
+	}
+	return out;
+}
+
+bool Profiler::writeTrace(const std::string& path, size_t frames) const {
+	std::FILE* file = std::fopen(path.c_str(), "w");
+	if (!file) return false;
+
+	// the frame still going is left out
+	size_t last = history.empty() ? 0 : history.size() - 1;
+	size_t first = last > frames ? last - frames : 0;
+
+	std::fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+	std::fprintf(file, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"wacky-snake\"}}");
+	std::fprintf(file, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"GPU\"}}", gpuTrack);
+	{
+		std::lock_guard lock(ringsMutex);
+		for (size_t track = 0; track < trackNames.size(); ++track) {
+			std::fprintf(file, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %zu, \"args\": {\"name\": \"%s\"}}",
+				track, escape(trackNames[track]).c_str());
+		}
+	}
+
+	for (size_t i = first; i < last; ++i) {
+		for (const auto& event : history[i].events) {
+			// complete events, microseconds
+			std::fprintf(file, ",\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f, "
+				"\"args\": {\"frame\": %u}}",
+				escape(event.name).c_str(), event.track == gpuTrack ? "gpu" : "cpu", event.track, (double) event.start / 1e3,
+				(double) (event.end - event.start) / 1e3, event.frame);
+		}
+	}
+	std::fprintf(file, "\n]}\n");
+	return std::fclose(file) == 0;
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <array>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// where a frame goes, cpu scopes from any thread and gpu timestamps, kept for the last few hundred frames
+// recording never takes a lock, every thread writes its own ring and only endFrame on the main thread reads them
+// usage: ProfileScope scope("setupMesh"); at the top of whatever should show up
+
+struct ProfileEvent {
+	// a string literal, compared by pointer
+	const char* name;
+	// ns on Profiler::now()
+	uint64_t start;
+	uint64_t end;
+	uint32_t frame;
+	// the ring it was recorded on, or Profiler::gpuTrack
+	uint32_t track;
+};
+
+// events of one thread, the owner pushes and never waits, the reader skips whatever the owner lapped before it got there
+class ProfileRing {
+public:
+	static constexpr size_t capacity = 4096;
+
+private:
+	struct Slot {
+		std::atomic<const char*> name{ nullptr };
+		std::atomic<uint64_t> start{ 0 };
+		std::atomic<uint64_t> end{ 0 };
+		std::atomic<uint32_t> frame{ 0 };
+	};
+
+	std::array<Slot, capacity> slots;
+	// events pushed so far
+	std::atomic<uint64_t> head{ 0 };
+	// one past the event being written, moves before the slot is touched so the reader can tell what's torn
+	std::atomic<uint64_t> writing{ 0 };
+	// reader side, events drained so far
+	uint64_t tail = 0;
+
+public:
+	const uint32_t track;
+
+	explicit ProfileRing(uint32_t track) : track(track) {}
+
+	void push(const char* name, uint64_t start, uint64_t end, uint32_t frame);
+
+	// appends what was pushed since the last drain to out, returns how many were overwritten before they could be read
+	size_t drain(std::vector<ProfileEvent>& out);
+};
+
+class Profiler {
+private:
+	struct Frame {
+		uint32_t frame;
+		std::vector<ProfileEvent> events;
+	};
+
+	std::atomic<bool> on{ false };
+	std::atomic<uint32_t> current{ 0 };
+	uint64_t frameStart = 0;
+
+	// rings live as long as the profiler, threads that exit hand theirs back for the next thread to use
+	mutable std::mutex ringsMutex;
+	std::vector<std::unique_ptr<ProfileRing>> rings;
+	std::vector<ProfileRing*> spareRings;
+	std::vector<std::string> trackNames;
+
+	// oldest first, consecutive frame numbers
+	std::deque<Frame> history;
+	std::vector<ProfileEvent> drained;
+	uint64_t lost = 0;
+
+	friend class ProfileRingLease;
+	ProfileRing* takeRing();
+	void giveBack(ProfileRing* ring);
+	ProfileRing& threadRing();
+
+public:
+	// frames kept for summaries and traces
+	static constexpr size_t historyFrames = 600;
+	static constexpr uint32_t gpuTrack = 0xFFFFFFFF;
+	// name of the event endFrame records for every frame
+	static constexpr const char* frameName = "frame";
+
+	static Profiler& instance();
+
+	// ns since the first call, on a steady clock
+	static uint64_t now();
+
+	[[nodiscard]] bool enabled() const { return on.load(std::memory_order_relaxed); }
+	void setEnabled(bool enabled);
+
+	[[nodiscard]] uint32_t frame() const { return current.load(std::memory_order_relaxed); }
+
+	// shows up as the name of the calling thread's track in traces
+	void nameThread(const std::string& name);
+
+	// a cpu span on the calling thread, in the current frame
+	void record(const char* name, uint64_t start, uint64_t end) {
+		threadRing().push(name, start, end, frame());
+	}
+
+	// a gpu span of an earlier frame, main thread only, times already moved onto now()'s clock
+	void recordGpu(const char* name, uint64_t start, uint64_t end, uint32_t frame);
+
+	// main thread, once a frame: closes the frame, collects every thread's events and starts the next frame
+	void endFrame();
+
+	// p50 and p99 per frame of every scope over the last frames, leaving out the newest skip, which may still be
+	// missing their gpu times
+	[[nodiscard]] std::string summary(size_t frames = 300, size_t skip = 4) const;
+
+	// the last frames as a chrome://tracing / Perfetto json, false if the file can't be written
+	bool writeTrace(const std::string& path, size_t frames) const;
+};
+
+// times the enclosing scope, costs a relaxed load while the profiler is off
+class ProfileScope {
+private:
+	const char* name;
+	uint64_t start;
+
+public:
+	explicit ProfileScope(const char* name) :
+		name(Profiler::instance().enabled() ? name : nullptr),
+		start(this->name ? Profiler::now() : 0) {}
+
+	~ProfileScope() {
+		if (name) Profiler::instance().record(name, start, Profiler::now());
+	}
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+};
@@ -1,5 +1,7 @@
 #include "RenderEngine.hpp"
 #include "Mesh.hpp"
+#include "Profiler.hpp"
+#include "game/Parallel.hpp"
 #include <GLFW/glfw3.h>
 #include <GL/glew.h>
 #include <glm/gtc/matrix_transform.hpp>
@@ -7,21 +9,35 @@
 #include "Main.hpp"
 #include <iostream>
 
+// a stretch of a buffer the fill functions write to, so parts of one buffer can be filled from several threads
+struct StagingView {
+	char8_t* pointer;
+	size_t size;
+};
+
+// below this many points or instances per worker, starting threads costs more than it saves
+constexpr size_t snakePointsPerThread = 16384;
+constexpr size_t foodsPerThread = 65536;
+
+static unsigned workersFor(size_t items, size_t perThread) {
+	return (unsigned) std::clamp<size_t>(items / perThread, 1, defaultThreads());
+}
+
 Camera::Camera() : matrix(), rotation(160.0f, 30.0f), fov(60.0f) {}
 
 void Camera::updateProjection(GameWindow& gameWindow) {
 	this->matrix.projection = glm::perspective(glm::radians(this->fov), (float) gameWindow.windowSize.x / (float) gameWindow.windowSize.y, 0.001f, 512.0f);
 }
 	
-void Camera::updateModelView(Game& game, glm::vec2 mousePosDelta) {
+void Camera::updateModelView(const RenderState& state, glm::vec2 mousePosDelta, float tickDelta) {
 	float mouseSpeed = 0.1f;
 	this->rotation += mousePosDelta * mouseSpeed;
 	this->rotation.y = std::clamp(this->rotation.y, -90.0f, 90.0f);
 	this->matrix.modelView = glm::identity<glm::mat4>();
 	this->matrix.modelView = glm::rotate(this->matrix.modelView, glm::radians(this->rotation.y), glm::vec3(1.0f, 0.0f, 0.0f));
 	this->matrix.modelView = glm::rotate(this->matrix.modelView, glm::radians(this->rotation.x), glm::vec3(0.0f, 1.0f, 0.0f));
-	if (game.player.segments.size() > 0) {
-		this->matrix.modelView = glm::translate(this->matrix.modelView, -game.player.segments[0]);
+	if (!state.snakes.empty() && state.snakes[0].count > 1) {
+		this->matrix.modelView = glm::translate(this->matrix.modelView, -state.snake(0, tickDelta).head);
 	}
 	glm::vec2 sin = glm::sin(glm::radians(this->rotation));
 	glm::vec2 cos = glm::cos(glm::radians(this->rotation));
@@ -32,47 +48,47 @@ void Camera::updateModelView(Game& game, glm::vec2 mousePosDelta) {
 SkyboxRenderer::SkyboxRenderer(RenderEngine& renderEngine): renderEngine(renderEngine), borderShaderProgram("resources/shaders/Border.vert.glsl", "resources/shaders/Border.frag.glsl") {	
 	glm::vec3 borderVertices[] = {
 		// Down
-		{ 64.0f, -64.0f, -64.0f },
-		{ -64.0f, -64.0f, -64.0f },
-		{ 64.0f, -64.0f, 64.0f},
-		{ -64.0f, -64.0f, 64.0f },
-		{ 64.0f, -64.0f, 64.0f },
-		{ -64.0f, -64.0f, -64.0f },
+		{ 1.0f, -1.0f, -1.0f },
+		{ -1.0f, -1.0f, -1.0f },
+		{ 1.0f, -1.0f, 1.0f},
+		{ -1.0f, -1.0f, 1.0f },
+		{ 1.0f, -1.0f, 1.0f },
+		{ -1.0f, -1.0f, -1.0f },
 		// Up
-		{ 64.0f, 64.0f, -64.0f },
-		{ 64.0f, 64.0f, 64.0f },
-		{ -64.0f, 64.0f, -64.0f },
-		{ -64.0f, 64.0f, 64.0f },
-		{ -64.0f, 64.0f, -64.0f },
-		{ 64.0f, 64.0f, 64.0f },
+		{ 1.0f, 1.0f, -1.0f },
+		{ 1.0f, 1.0f, 1.0f },
+		{ -1.0f, 1.0f, -1.0f },
+		{ -1.0f, 1.0f, 1.0f },
+		{ -1.0f, 1.0f, -1.0f },
+		{ 1.0f, 1.0f, 1.0f },
 		// West
-		{ -64.0f, -64.0f, -64.0f },
-		{ -64.0f, 64.0f, -64.0f },
-		{ -64.0f, -64.0f, 64.0f },
-		{ -64.0f, 64.0f, 64.0f },
-		{ -64.0f, -64.0f, 64.0f },
-		{ -64.0f, 64.0f, -64.0f },
+		{ -1.0f, -1.0f, -1.0f },
+		{ -1.0f, 1.0f, -1.0f },
+		{ -1.0f, -1.0f, 1.0f },
+		{ -1.0f, 1.0f, 1.0f },
+		{ -1.0f, -1.0f, 1.0f },
+		{ -1.0f, 1.0f, -1.0f },
 		// East
-		{ 64.0f, -64.0f, -64.0f },
-		{ 64.0f, -64.0f, 64.0f },
-		{ 64.0f, 64.0f, -64.0f },
-		{ 64.0f, 64.0f, 64.0f },
-		{ 64.0f, 64.0f, -64.0f },
-		{ 64.0f, -64.0f, 64.0f },
+		{ 1.0f, -1.0f, -1.0f },
+		{ 1.0f, -1.0f, 1.0f },
+		{ 1.0f, 1.0f, -1.0f },
+		{ 1.0f, 1.0f, 1.0f },
+		{ 1.0f, 1.0f, -1.0f },
+		{ 1.0f, -1.0f, 1.0f },
 		// South
-		{ -64.0f, -64.0f, -64.0f },
-		{ 64.0f, -64.0f, -64.0f },
-		{ -64.0f, 64.0f, -64.0f },
-		{ 64.0f, 64.0f, -64.0f },
-		{ -64.0f, 64.0f, -64.0f },
-		{ 64.0f, -64.0f, -64.0f },
+		{ -1.0f, -1.0f, -1.0f },
+		{ 1.0f, -1.0f, -1.0f },
+		{ -1.0f, 1.0f, -1.0f },
+		{ 1.0f, 1.0f, -1.0f },
+		{ -1.0f, 1.0f, -1.0f },
+		{ 1.0f, -1.0f, -1.0f },
 		// North
-		{ -64.0f, -64.0f, 64.0f },
-		{ -64.0f, 64.0f, 64.0f },
-		{ 64.0f, -64.0f, 64.0f },
-		{ 64.0f, 64.0f, 64.0f },
-		{ 64.0f, -64.0f, 64.0f },
-		{ -64.0f, 64.0f, 64.0f }
+		{ -1.0f, -1.0f, 1.0f },
+		{ -1.0f, 1.0f, 1.0f },
+		{ 1.0f, -1.0f, 1.0f },
+		{ 1.0f, 1.0f, 1.0f },
+		{ 1.0f, -1.0f, 1.0f },
+		{ -1.0f, 1.0f, 1.0f }
 	};
 	this->borderVBO.allocate(&borderVertices, sizeof(borderVertices), 0);
 	this->borderVAO.attachVertexBuffer(
@@ -84,6 +100,7 @@ SkyboxRenderer::SkyboxRenderer(RenderEngine& renderEngine): renderEngine(renderE
 }
 
 void SkyboxRenderer::render(GameWindow& gameWindow) {
+	GpuProfileScope gpuScope(this->renderEngine.gpuProfiler, "border");
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	this->borderShaderProgram.bind();
@@ -94,14 +111,51 @@ void SkyboxRenderer::render(GameWindow& gameWindow) {
 
 RenderEngine::RenderEngine(): 
 	skyboxRenderer(*this), 
-	buffer(1024 * 1024 * 8),
-	genericDrawShaderProgram("resources/shaders/GenericDraw.vert.glsl", "resources/shaders/GenericDraw.frag.glsl"), 
-	worldObjVertexCount(0), snakeVertexCount(0) {
-	globalUBO.allocate(268, GL_DYNAMIC_STORAGE_BIT);
+	buffer(1024 * 1024 * 2),
+	foodShaderProgram("resources/shaders/FoodInstanced.vert.glsl", "resources/shaders/GenericDraw.frag.glsl"),
+	foodImpostorProgram("resources/shaders/FoodImpostor.vert.glsl", "resources/shaders/FoodImpostor.frag.glsl"),
+	foodCullProgram("resources/shaders/FoodCull.comp.glsl"),
+	snakeShaderProgram("resources/shaders/SnakeBody.vert.glsl", "resources/shaders/GenericDraw.frag.glsl"),
+	snakeCullProgram("resources/shaders/SnakeCull.comp.glsl"),
+	visibleSegmentsCapacity(0), snakePointsOffset(0), snakePointCount(0) {
+	globalUBO.allocate(272, GL_DYNAMIC_STORAGE_BIT);
+	foodCommands.allocate(sizeof(FoodCommands), GL_DYNAMIC_STORAGE_BIT);
+	snakeCommand.allocate(sizeof(DrawArraysIndirectCommand), GL_DYNAMIC_STORAGE_BIT);
+
+	GLint alignment = 0;
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	storageAlignment = (size_t) std::max(alignment, (GLint) snakePointSize);
+
+	FoodMesh foodMesh = createFoodMesh();
+	foodMeshVBO.allocate(foodMesh.vertices.data(), (GLsizeiptr) (foodMesh.vertices.size() * sizeof(PackedVertex)), 0);
+	foodMeshEBO.allocate(foodMesh.indices.data(), (GLsizeiptr) (foodMesh.indices.size() * sizeof(uint16_t)), 0);
+	foodMeshLevels = foodMesh.levels;
+
+	// growing the visible buffer keeps its name, so this never has to change
+	foodVAO.attachVertexBuffer(
+		foodMeshVBO,
+		OpenGL::VertexAttribute::Builder((GLsizei) sizeof(PackedVertex))
+		.addFloat(0, 4, GL_SHORT, true)
+		.addFloat(1, 4, GL_INT_2_10_10_10_REV, true)
+		.build()
+	);
+	for (auto* vao : { &foodVAO, &foodImpostorVAO }) {
+		vao->attachVertexBuffer(
+			foodObjects.visible,
+			OpenGL::VertexAttribute::Builder((GLsizei) foodInstanceSize, 1)
+			.addFloat(2, 3, GL_FLOAT, false)
+			.addFloat(3, 1, GL_HALF_FLOAT, false)
+			.addInt(4, 1, GL_UNSIGNED_BYTE)
+			.addPadding(1)
+			.build()
+		);
+	}
+	foodVAO.attachElementBuffer(foodMeshEBO);
 }
 
-void setupUBO(RenderEngine& renderEngine, GameWindow& gameWindow, float tickDelta) {
-	char mem[268];
+void setupUBO(RenderEngine& renderEngine, GameWindow& gameWindow, const RenderState& state, float tickDelta) {
+	ProfileScope scope("setupUBO");
+	char mem[272];
 	size_t i = 0;
 	memcpy(mem + i, &renderEngine.camera.matrix, sizeof(ProjViewModelMatrix));
 	i += sizeof(ProjViewModelMatrix);
@@ -117,86 +171,220 @@ void setupUBO(RenderEngine& renderEngine, GameWindow& gameWindow, float tickDelt
 	memcpy(mem + i, &windowSize, sizeof(glm::vec2));
 	i += sizeof(glm::vec2);
 
-	mem[i] = tickDelta;
+	memcpy(mem + i, &tickDelta, sizeof(float));
+	i += sizeof(float);
+
+	// the border is a unit cube, this scales it out to the walls
+	float arenaHalf = (float) state.half;
+	memcpy(mem + i, &arenaHalf, sizeof(float));
 
 	renderEngine.globalUBO.invalidate();
-	glNamedBufferSubData(renderEngine.globalUBO.id, 0, 268, mem);
+	glNamedBufferSubData(renderEngine.globalUBO.id, 0, 272, mem);
 }
 
-void setupMesh(RenderEngine& renderEngine, Game& game, float tickDelta) {
+void setupMesh(RenderEngine& renderEngine, const RenderState& state, float tickDelta) {
+	ProfileScope scope("setupMesh");
 	renderEngine.buffer.update();
-	std::vector<ItemObj>& worldObjs = game.world.objects;
-	for (auto& obj : worldObjs) {
-		switch (obj.item) {
-			case Item::Food:
-				fillFoodMeshInterleaved(renderEngine.buffer, obj.pos, obj.radius, { 1.0f, 0.0f, 0.0f, 1.0f });
-				break;
-			default:
-				// ADD more
-				break;
+	renderEngine.foodObjects.sync(state);
+
+	size_t points = state.points.size();
+	renderEngine.snakePointCount = 0;
+	// snakes that don't fit wait for the next frame, the buffer grows for them by then
+	if (points < 2 || !renderEngine.buffer.reserve(points * snakePointSize, renderEngine.storageAlignment)) return;
+
+	renderEngine.snakePointsOffset = renderEngine.buffer.offset();
+	// every snake's points have their own place in the allocation, so snakes fill across threads
+	char8_t* start = renderEngine.buffer.pointer;
+	parallelFor(state.snakes.size(), workersFor(points, snakePointsPerThread), [&](size_t begin, size_t end) {
+		StagingView out{ start + state.snakes[begin].first * snakePointSize, 0 };
+		for (size_t i = begin; i < end; ++i) {
+			fillSnakePoints(state.snake(i, tickDelta), out, i == 0 ? SnakeColor::Player : SnakeColor::Other);
 		}
-	}
-	renderEngine.worldObjVAO.clearAttachments();
-	renderEngine.worldObjVAO.attachVertexBuffer(
-		renderEngine.buffer.buffer,
-		renderEngine.buffer.offset(),
-		OpenGL::VertexAttribute::Builder(40)
-		.addFloat(0, 3, GL_FLOAT, false)
-		.addFloat(1, 3, GL_FLOAT, false)
-		.addFloat(2, 4, GL_FLOAT, false)
-		.build()
-	);
-	renderEngine.worldObjVertexCount = renderEngine.buffer.size / 40;
+	});
+	renderEngine.buffer.size = points * snakePointSize;
+	renderEngine.snakePointCount = (GLuint) points;
 	renderEngine.buffer.finish();
 
-	fillSnakeMeshInterleaved(game.player.segments, renderEngine.buffer, Snake::radius, glm::vec4(0.1f, 0.8f, 0.1f, 1.0f));
-	renderEngine.snakeVAO.clearAttachments();
-	renderEngine.snakeVAO.attachVertexBuffer(
-		renderEngine.buffer.buffer,
-		renderEngine.buffer.offset(),
-		OpenGL::VertexAttribute::Builder(40)
-		.addFloat(0, 3, GL_FLOAT, false)
-		.addFloat(1, 3, GL_FLOAT, false)
-		.addFloat(2, 4, GL_FLOAT, false)
-		.build()
-	);
-	renderEngine.snakeVertexCount = renderEngine.buffer.size / 40;
-	renderEngine.buffer.finish();
+	// a segment per point at most
+	if (points > renderEngine.visibleSegmentsCapacity) {
+		renderEngine.visibleSegmentsCapacity = std::max(points, renderEngine.visibleSegmentsCapacity * 2);
+		renderEngine.visibleSegments.allocate((GLsizeiptr) (renderEngine.visibleSegmentsCapacity * sizeof(GLuint)), GL_DYNAMIC_COPY);
+	}
+}
+
+bool RenderEngine::ready() {
+	// every program gets asked, each one finishes as soon as it can
+	bool ready = true;
+	for (auto* program : { &skyboxRenderer.borderShaderProgram, &foodShaderProgram, &foodImpostorProgram, &foodCullProgram,
+		&snakeShaderProgram, &snakeCullProgram }) {
+		ready = program->ready() && ready;
+	}
+	return ready;
+}
+
+void RenderEngine::setup(GameWindow& gameWindow, const RenderState& state, float tickDelta) {
+	// first gl work of the frame, so the queries it reads back are the oldest ones
+	this->gpuProfiler.beginFrame();
+	setupUBO(*this, gameWindow, state, tickDelta);
+	setupMesh(*this, state, tickDelta);
 }
 
-void RenderEngine::setup(GameWindow& gameWindow, Game& game, float tickDelta) {
-	setupUBO(*this, gameWindow, tickDelta);
-	setupMesh(*this, game, tickDelta);
+void RenderEngine::cull() {
+	GpuProfileScope gpuScope(this->gpuProfiler, "cull");
+	constexpr GLuint groupSize = 64;
+
+	// FoodCull.comp's base pass fills in the baseInstances from the counts
+	FoodCommands foods{};
+	std::array<float, foodLevels> levelRadius;
+	for (size_t i = 0; i < foodLevels; ++i) {
+		const FoodLevel& level = this->foodMeshLevels[i];
+		foods.levels[i] = { level.indexCount, 0, level.firstIndex, level.baseVertex, 0 };
+		levelRadius[i] = level.maxRadius;
+	}
+	foods.impostors = { 6, 0, 0, 0 };
+	glNamedBufferSubData(this->foodCommands.id, 0, sizeof(foods), &foods);
+	if (this->foodObjects.count > 0) {
+		this->foodCullProgram.bind();
+		// bound in the order of the shader's bindings
+		this->foodCullProgram.bindBuffer(GL_UNIFORM_BUFFER, this->globalUBO, "Global");
+		this->foodCullProgram.bindBuffer(GL_SHADER_STORAGE_BUFFER, this->foodObjects.buffer, "Objects");
+		this->foodCullProgram.bindBuffer(GL_SHADER_STORAGE_BUFFER, this->foodObjects.visible, "VisibleFoods");
+		this->foodCullProgram.bindBuffer(GL_SHADER_STORAGE_BUFFER, this->foodCommands, "DrawCommands");
+		glProgramUniform1ui(this->foodCullProgram.id, 0, (GLuint) this->foodObjects.count);
+		glProgramUniform1fv(this->foodCullProgram.id, 1, (GLsizei) foodLevels, levelRadius.data());
+		// count what every command gets, turn the counts into where each one starts, then write them there
+		GLuint groups = ((GLuint) this->foodObjects.count + groupSize - 1) / groupSize;
+		enum : GLuint { countPass, basePass, writePass };
+		glProgramUniform1ui(this->foodCullProgram.id, 4, countPass);
+		glDispatchCompute(groups, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		glProgramUniform1ui(this->foodCullProgram.id, 4, basePass);
+		glDispatchCompute(1, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		glProgramUniform1ui(this->foodCullProgram.id, 4, writePass);
+		glDispatchCompute(groups, 1, 1);
+	}
+
+	DrawArraysIndirectCommand snakes{ 36, 0, 0, 0 };
+	glNamedBufferSubData(this->snakeCommand.id, 0, sizeof(snakes), &snakes);
+	if (this->snakePointCount > 0) {
+		this->snakeCullProgram.bind();
+		this->snakeCullProgram.bindBuffer(GL_UNIFORM_BUFFER, this->globalUBO, "Global");
+		this->snakeCullProgram.bindBuffer(GL_SHADER_STORAGE_BUFFER, this->buffer.buffer, "SnakePoints",
+			this->snakePointsOffset, (GLsizeiptr) this->snakePointCount * snakePointSize);
+		this->snakeCullProgram.bindBuffer(GL_SHADER_STORAGE_BUFFER, this->visibleSegments, "VisibleSegments");
+		this->snakeCullProgram.bindBuffer(GL_SHADER_STORAGE_BUFFER, this->snakeCommand, "DrawCommand");
+		glProgramUniform1ui(this->snakeCullProgram.id, 0, this->snakePointCount);
+		glProgramUniform1f(this->snakeCullProgram.id, 1, Snake::radius);
+		glDispatchCompute((this->snakePointCount + groupSize - 1) / groupSize, 1, 1);
+	}
+
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
 }
 
 void RenderEngine::render(GameWindow& gameWindow, float tickDelta) {
+	ProfileScope scope("render");
+	this->cull();
 	this->skyboxRenderer.render(gameWindow);
 	glEnable(GL_DEPTH_TEST);
-	this->genericDrawShaderProgram.bind();
-	this->genericDrawShaderProgram.bindBuffer(GL_UNIFORM_BUFFER, this->globalUBO, "Global");
-	this->worldObjVAO.bind();
-	glDrawArrays(GL_TRIANGLES, 0, this->worldObjVertexCount);
-	this->snakeVAO.bind();
-	glDrawArrays(GL_TRIANGLES, 0, this->snakeVertexCount);
+	{
+		GpuProfileScope gpuScope(this->gpuProfiler, "foods");
+		this->foodShaderProgram.bind();
+		this->foodShaderProgram.bindBuffer(GL_UNIFORM_BUFFER, this->globalUBO, "Global");
+		this->foodVAO.bind();
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, this->foodCommands.id);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, nullptr, (GLsizei) foodLevels, 0);
+	}
+	{
+		GpuProfileScope gpuScope(this->gpuProfiler, "impostors");
+		this->foodImpostorProgram.bind();
+		this->foodImpostorProgram.bindBuffer(GL_UNIFORM_BUFFER, this->globalUBO, "Global");
+		this->foodImpostorVAO.bind();
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, this->foodCommands.id);
+		glDrawArraysIndirect(GL_TRIANGLES, (const void*) offsetof(FoodCommands, impostors));
+	}
+	if (this->snakePointCount > 0) {
+		GpuProfileScope gpuScope(this->gpuProfiler, "snakes");
+		this->snakeShaderProgram.bind();
+		this->snakeShaderProgram.bindBuffer(GL_UNIFORM_BUFFER, this->globalUBO, "Global");
+		this->snakeShaderProgram.bindBuffer(GL_SHADER_STORAGE_BUFFER, this->buffer.buffer, "SnakePoints",
+			this->snakePointsOffset, (GLsizeiptr) this->snakePointCount * snakePointSize);
+		this->snakeShaderProgram.bindBuffer(GL_SHADER_STORAGE_BUFFER, this->visibleSegments, "VisibleSegments");
+		glProgramUniform1f(this->snakeShaderProgram.id, 1, Snake::radius);
+		this->snakeVAO.bind();
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, this->snakeCommand.id);
+		glDrawArraysIndirect(GL_TRIANGLES, nullptr);
+	}
+	this->buffer.fence();
 }
 
-PersistentMappedBuffer::PersistentMappedBuffer(GLsizeiptr size) : frame(0), size(0) {
-	this->buffer.allocate(size, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+PersistentMappedBuffer::PersistentMappedBuffer(size_t regionSize) :
+	fences(), frame(0), regionSize(regionSize), wanted(regionSize), size(0), stats() {
+	map();
+}
+
+void PersistentMappedBuffer::map() {
+	GLsizeiptr bytes = (GLsizeiptr) (regionSize * framesInFlight);
+	this->buffer.allocate(bytes, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+	// synchronized by the fences instead
 	this->originPtr = (char8_t*) glMapNamedBufferRange(
 		this->buffer.id,
 		0,
-		size,
+		bytes,
 		GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT | GL_MAP_UNSYNCHRONIZED_BIT
 	);
-	this->pointer = this->originPtr;
+	this->pointer = this->originPtr + regionStart();
 }
 
 void PersistentMappedBuffer::update() {
-	frame++;
-	if (frame == 2) {
-		pointer = originPtr;
-		frame = 0;
+	frame = (frame + 1) % framesInFlight;
+
+	if (wanted > regionSize && regionSize < maxRegionSize) {
+		// storage is immutable, so growing is a new buffer, gl keeps the old one alive until the frames reading it are done
+		regionSize = std::min(std::max(regionSize * 2, wanted), maxRegionSize);
+		for (auto& fence : fences) {
+			if (fence) glDeleteSync(fence);
+			fence = nullptr;
+		}
+		glUnmapNamedBuffer(buffer.id);
+		buffer.destroy();
+		glCreateBuffers(1, &buffer.id);
+		map();
+		stats.grows++;
+	}
+
+	GLsync& fence = fences[frame];
+	if (fence) {
+		if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+			ProfileScope scope("streamStall");
+			uint64_t start = Profiler::now();
+			// flushes once so the fence can't wait on commands that were never sent
+			GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+			while (glClientWaitSync(fence, flags, 1000000) == GL_TIMEOUT_EXPIRED) {
+				flags = 0;
+			}
+			stats.stalls++;
+			stats.stallNs += Profiler::now() - start;
+		}
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+
+	pointer = originPtr + regionStart();
+	size = 0;
+}
+
+bool PersistentMappedBuffer::reserve(size_t bytes, size_t alignment) {
+	finish();
+	size_t start = (offset() + alignment - 1) / alignment * alignment;
+	size_t end = regionStart() + regionSize;
+	if (start > end || bytes > end - start) {
+		stats.overflows++;
+		wanted = std::max(wanted, start - regionStart() + bytes);
+		return false;
 	}
+	pointer = originPtr + start;
+	return true;
 }
 
 void PersistentMappedBuffer::finish() {
@@ -204,6 +392,92 @@ void PersistentMappedBuffer::finish() {
 	size = 0;
 }
 
+void PersistentMappedBuffer::fence() {
+	stats.highWater = std::max(stats.highWater, (size_t) offset() + size - regionStart());
+	GLsync& fence = fences[frame];
+	if (fence) glDeleteSync(fence);
+	fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
 GLuint PersistentMappedBuffer::offset() const {
 	return (GLuint) (pointer - originPtr);
 }
+
+size_t PersistentMappedBuffer::room() const {
+	return regionStart() + regionSize - offset() - size;
+}
+
+FoodObjectBuffer::FoodObjectBuffer() : version(0), capacity(0), count(0) {
+	grow(4096, false);
+}
+
+void FoodObjectBuffer::grow(size_t objects, bool keep) {
+	GLsizeiptr kept = (GLsizeiptr) (keep ? capacity * foodInstanceSize : 0);
+	capacity = std::max(capacity * 2, objects);
+
+	// the name stays, the vaos and the cull have it attached, so the contents take a detour
+	OpenGL::BufferObject::Mutable old;
+	if (kept > 0) {
+		old.allocate(kept, GL_STATIC_COPY);
+		glCopyNamedBufferSubData(buffer.id, old.id, 0, 0, kept);
+	}
+	buffer.allocate((GLsizeiptr) (capacity * foodInstanceSize), GL_DYNAMIC_DRAW);
+	if (kept > 0) glCopyNamedBufferSubData(old.id, buffer.id, 0, 0, kept);
+	// IGLObject's destructor doesn't reach it
+	old.destroy();
+
+	// written and read by the gpu only
+	visible.allocate((GLsizeiptr) (capacity * foodInstanceSize), GL_DYNAMIC_COPY);
+}
+
+static void writeFood(StagingView& out, const ItemObj& obj) {
+	switch (obj.item) {
+		case Item::Food:
+			fillFoodInstance(out, obj.pos, obj.radius, FoodColor::Red);
+			break;
+		default:
+			// ADD more, empty slots collapse to a point and draw nothing
+			fillFoodInstance(out, obj.pos, 0.0f, FoodColor::None);
+			break;
+	}
+}
+
+void FoodObjectBuffer::sync(const RenderState& state) {
+	// frames that drew the same state again
+	if (state.version == version) return;
+	version = state.version;
+	count = (GLsizei) state.objectCount;
+
+	if (state.rebuilt) {
+		const std::vector<ItemObj>& objects = state.objects;
+		// the old contents are gone with the reallocation, they all go up again anyway
+		if (objects.size() > capacity) grow(objects.size(), false);
+
+		staging.resize(objects.size() * foodInstanceSize);
+		parallelFor(objects.size(), workersFor(objects.size(), foodsPerThread), [&](size_t begin, size_t end) {
+			StagingView out{ staging.data() + begin * foodInstanceSize, 0 };
+			for (size_t i = begin; i < end; ++i) {
+				writeFood(out, objects[i]);
+			}
+		});
+		if (!staging.empty()) glNamedBufferSubData(buffer.id, 0, (GLsizeiptr) staging.size(), staging.data());
+		return;
+	}
+
+	// World::takeSlot appends slots for streamed chunks without a rebuild
+	if (state.objectCount > capacity) grow(state.objectCount, true);
+
+	// neighbouring slots go up as one run, a loaded chunk's slots mostly are, the simulation sorted them already
+	const std::vector<uint32_t>& changed = state.changed;
+	staging.resize(changed.size() * foodInstanceSize);
+	StagingView out{ staging.data(), 0 };
+	size_t run = 0;
+	for (size_t i = 0; i < changed.size(); ++i) {
+		writeFood(out, state.changedObjects[i]);
+		if (i + 1 < changed.size() && changed[i + 1] == changed[i] + 1) continue;
+
+		glNamedBufferSubData(buffer.id, (GLintptr) (changed[run] * foodInstanceSize), (GLsizeiptr) ((i + 1 - run) * foodInstanceSize),
+			out.pointer + run * foodInstanceSize);
+		run = i + 1;
+	}
+}
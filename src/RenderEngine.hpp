@@ -1,9 +1,13 @@
 #pragma once
 
 #include "game/Game.hpp"
+#include "game/RenderState.hpp"
 #include <glm/glm.hpp>
 #include "GLObjects.hpp"
+#include "GpuProfiler.hpp"
+#include "mesh.hpp"
 #include "Main.hpp"
+#include <array>
 
 class RenderEngine;
 
@@ -21,7 +25,7 @@ public:
 	Camera();
 
 	void updateProjection(GameWindow& gameWindow);
-	void updateModelView(Game& game, glm::vec2 mousePosDelta);
+	void updateModelView(const RenderState& state, glm::vec2 mousePosDelta, float tickDelta);
 };
 
 struct SkyboxRenderer {
@@ -36,20 +40,105 @@ struct SkyboxRenderer {
     void render(GameWindow& gameWindow);
 };
 
+// per frame vertex data, one region of the mapped buffer per frame in flight, each fenced after the frame's draws
+// usage: update() at the start of a frame, then reserve(), write at pointer + size, finish() for every allocation,
+// fence() once the frame's draws are submitted
 class PersistentMappedBuffer {
+public:
+	static constexpr size_t framesInFlight = 3;
+	// regions don't grow past this, allocations that still don't fit are refused
+	static constexpr size_t maxRegionSize = 64 * 1024 * 1024;
+
+	struct Stats {
+		// update() waiting on the gpu to be done with a region
+		uint64_t stalls = 0;
+		uint64_t stallNs = 0;
+		// most bytes a frame used
+		size_t highWater = 0;
+		// reserves refused for lack of room, and how often the buffer grew because of them
+		uint64_t overflows = 0;
+		uint64_t grows = 0;
+	};
+
 private:
-	uint32_t frame;
+	std::array<GLsync, framesInFlight> fences;
+	size_t frame;
+	size_t regionSize;
+	// what the fullest frame asked for, the next update() grows to fit it
+	size_t wanted;
+
+	void map();
+	[[nodiscard]] size_t regionStart() const { return frame * regionSize; }
+
 public:
 	OpenGL::BufferObject::Immutable buffer;
 	char8_t* originPtr;
+	// start of the current allocation and the bytes written to it
 	char8_t* pointer;
 	size_t size;
+	Stats stats;
 
-	PersistentMappedBuffer(GLsizeiptr size);
+	explicit PersistentMappedBuffer(size_t regionSize);
+	// moves on to the next region, waiting if the gpu still reads it
 	void update();
+	// starts an allocation of up to bytes at a multiple of alignment, false if it doesn't fit in this frame's region
+	[[nodiscard]] bool reserve(size_t bytes, size_t alignment = 4);
 	void finish();
+	// after the last draw reading this frame's region
+	void fence();
 	GLuint offset() const;
+	// bytes that can still be written this frame
+	size_t room() const;
+	[[nodiscard]] size_t capacity() const { return regionSize; }
+};
+
+// every world object as a food instance, kept on the gpu and patched where the RenderStates say something changed
+// empty slots stay in as zero radius instances so an object's index is its instance
+class FoodObjectBuffer {
+private:
+	// instances of one upload
+	std::vector<char8_t> staging;
+	// RenderState::version of the last sync
+	uint64_t version;
+
+	// keep copies what the gpu holds across, streamed chunks add slots between rebuilds
+	void grow(size_t objects, bool keep);
+
+public:
+	OpenGL::BufferObject::Mutable buffer;
+	// the instances FoodCull.comp found in view, what the food draws read, every FoodCommands command gets the run
+	// of them its count pass left room for, so capacity of them covers everything
+	OpenGL::BufferObject::Mutable visible;
+	size_t capacity;
+	GLsizei count;
+
+	FoodObjectBuffer();
+	// uploads what changed up to state, everything after a restart or a load, nothing if state was synced already
+	void sync(const RenderState& state);
+};
+
+// what glDrawArraysIndirect and glDrawElementsIndirect read, the culling passes count instanceCount up from 0
+struct DrawArraysIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint first;
+	GLuint baseInstance;
+};
+
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+// a command per food mesh level then the impostors, FoodCull.comp reads it as plain uints
+struct FoodCommands {
+	std::array<DrawElementsIndirectCommand, foodLevels> levels;
+	DrawArraysIndirectCommand impostors;
 };
+static_assert(sizeof(FoodCommands) == (foodLevels * 5 + 4) * sizeof(GLuint));
 
 class RenderEngine {
 public:
@@ -58,14 +147,40 @@ public:
 	PersistentMappedBuffer buffer;
 	SkyboxRenderer skyboxRenderer;
 	
-	OpenGL::ShaderProgram genericDrawShaderProgram;
-	OpenGL::VertexArrayObject worldObjVAO;
-	GLsizei worldObjVertexCount;
+	// foods in view are a subdivided icosahedron, more finely the bigger they are on screen, or a ray traced quad when
+	// small, the instances only get a position, radius and color each
+	OpenGL::ShaderProgram foodShaderProgram;
+	OpenGL::BufferObject::Immutable foodMeshVBO;
+	OpenGL::BufferObject::Immutable foodMeshEBO;
+	std::array<FoodLevel, foodLevels> foodMeshLevels;
+	OpenGL::VertexArrayObject foodVAO;
+	OpenGL::ShaderProgram foodImpostorProgram;
+	OpenGL::VertexArrayObject foodImpostorVAO;
+	FoodObjectBuffer foodObjects;
+	OpenGL::ShaderProgram foodCullProgram;
+	OpenGL::BufferObject::Immutable foodCommands;
+	// snakes are boxes the vertex shader builds from their points, the vao is empty, core profile just needs one bound
+	OpenGL::ShaderProgram snakeShaderProgram;
 	OpenGL::VertexArrayObject snakeVAO;
-	GLsizei snakeVertexCount;
+	OpenGL::ShaderProgram snakeCullProgram;
+	OpenGL::BufferObject::Immutable snakeCommand;
+	// first point of every segment in view
+	OpenGL::BufferObject::Mutable visibleSegments;
+	size_t visibleSegmentsCapacity;
+	// this frame's points in the mapped buffer
+	GLintptr snakePointsOffset;
+	GLuint snakePointCount;
+	// GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, the snake points are bound as a range of the mapped buffer
+	size_t storageAlignment;
+	// draw groups on the gpu timeline of the profiler
+	GpuProfiler gpuProfiler;
 	
 	RenderEngine();
 	
-	void setup(GameWindow& gameWindow, Game& game, float tickDelta);
+	// true once every program is linked, frames before that have nothing to draw with
+	bool ready();
+	void setup(GameWindow& gameWindow, const RenderState& state, float tickDelta);
+	// finds what's in view on the gpu, the draws after only get the count back through their indirect commands
+	void cull();
 	void render(GameWindow& gameWindow, float tickDelta);
 };
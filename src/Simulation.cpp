@@ -0,0 +1,114 @@
+#include "Simulation.hpp"
+
+#include <chrono>
+#include <algorithm>
+
+#include "Profiler.hpp"
+
+void Simulation::start() {
+	if (running.load(std::memory_order_relaxed)) return;
+
+	publish(Profiler::now());
+	running.store(true, std::memory_order_relaxed);
+	thread = std::thread([this] { run(); });
+}
+
+void Simulation::stop() {
+	if (!running.exchange(false)) return;
+	thread.join();
+	// anything posted after the last tick still happens
+	runCommands();
+}
+
+void Simulation::post(Command command) {
+	std::lock_guard lock(commandsMutex);
+	commands.push_back(std::move(command));
+}
+
+bool Simulation::runCommands() {
+	{
+		std::lock_guard lock(commandsMutex);
+		pending.swap(commands);
+	}
+	for (auto& command : pending) {
+		command(game);
+	}
+	bool ran = !pending.empty();
+	pending.clear();
+	return ran;
+}
+
+void Simulation::run() {
+	Profiler::instance().nameThread("simulation");
+
+	uint64_t last = Profiler::now();
+	while (running.load(std::memory_order_relaxed)) {
+		bool changed = runCommands();
+
+		uint64_t now = Profiler::now();
+		int steps = game.update((double) (now - last) / 1e9);
+		last = now;
+		if (steps > 0 && afterTicks) afterTicks(game);
+		if (steps > 0 || changed) publish(now);
+
+		// to the next tick, the scheduler may overshoot a little, the clock runs the tick late rather than losing it
+		double wait = game.clock.step - game.clock.accumulator;
+		std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+	}
+}
+
+void Simulation::publish(uint64_t tickTime) {
+	ProfileScope scope("publish");
+	RenderState& state = states.writing();
+	++version;
+
+	state.version = version;
+	state.tickTime = tickTime - (uint64_t) (game.clock.accumulator * 1e9);
+	state.step = game.clock.step;
+	state.half = game.world.half;
+
+	state.points.clear();
+	state.snakes.clear();
+	for (const auto& snake : game.snakes) {
+		Snake::Interpolated prev = snake.interpolated(0.0f);
+		state.snakes.push_back({ (uint32_t) state.points.size(), (uint32_t) snake.segments.size(), prev.head, prev.tail });
+		state.points.insert(state.points.end(), snake.segments.begin(), snake.segments.end());
+	}
+
+	// changes the renderer has synced past are done with, the rest go out again with their current values
+	const std::vector<ItemObj>& objects = game.world.objects;
+	if (game.world.takeChanges(taken)) {
+		rebuiltVersion = version;
+		changes.clear();
+	}
+	for (uint32_t index : taken) {
+		changes.push_back({ version, index });
+	}
+	uint64_t done = synced.load(std::memory_order_acquire);
+	changes.erase(changes.begin(), std::find_if(changes.begin(), changes.end(), [done](const Change& change) { return change.version > done; }));
+	// a renderer that fell that far behind is better off taking everything
+	if (changes.size() > objects.size()) {
+		rebuiltVersion = version;
+		changes.clear();
+	}
+
+	state.objectCount = objects.size();
+	state.rebuilt = rebuiltVersion > done;
+	state.changed.clear();
+	state.changedObjects.clear();
+	if (state.rebuilt) {
+		state.objects = objects;
+	} else {
+		state.objects.clear();
+		for (const auto& change : changes) {
+			state.changed.push_back(change.index);
+		}
+		std::sort(state.changed.begin(), state.changed.end());
+		state.changed.erase(std::unique(state.changed.begin(), state.changed.end()), state.changed.end());
+		for (uint32_t index : state.changed) {
+			state.changedObjects.push_back(objects[index]);
+		}
+	}
+
+	states.publish();
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+#include "game/Game.hpp"
+#include "game/RenderState.hpp"
+#include "game/TripleBuffer.hpp"
+
+// runs a game on its own thread at the clock's rate, the render thread only ever sees the RenderStates it publishes,
+// so vsync or a slow frame no longer holds ticks back and the next tick runs while the gpu draws the last one
+// usage: start(), then every frame take() and draw state(), post() whatever input does to the game
+class Simulation {
+public:
+	// runs on the simulation thread between ticks
+	using Command = std::function<void(Game&)>;
+
+private:
+	Game& game;
+	std::thread thread;
+	std::atomic<bool> running{ false };
+
+	std::mutex commandsMutex;
+	std::vector<Command> commands;
+	std::vector<Command> pending;
+
+	TripleBuffer<RenderState> states;
+	uint64_t version = 0;
+	// the last version the renderer synced its object mirror from, objects changed since then go in every state
+	std::atomic<uint64_t> synced{ 0 };
+	// objects World::takeChanges gave back, with the version they first went out in, oldest first
+	struct Change {
+		uint64_t version;
+		uint32_t index;
+	};
+	std::vector<Change> changes;
+	std::vector<uint32_t> taken;
+	// last version objects were replaced wholesale in
+	uint64_t rebuiltVersion = 0;
+
+	void run();
+	bool runCommands();
+	void publish(uint64_t tickTime);
+
+public:
+	// after every update that ran ticks, on the simulation thread, e.g. ReplayWriter::capture
+	std::function<void(Game&)> afterTicks;
+
+	explicit Simulation(Game& game) : game(game) {}
+	~Simulation() { stop(); }
+
+	Simulation(const Simulation&) = delete;
+	Simulation& operator=(const Simulation&) = delete;
+
+	// publishes the game as it is so there is a state before the first tick, then starts ticking
+	void start();
+	// finishes the tick going on, the game is the caller's again after
+	void stop();
+
+	// runs command before the next tick, in the order posted
+	void post(Command command);
+
+	// render thread, true if there is a newer state than the last take
+	bool take() { return states.take(); }
+	[[nodiscard]] const RenderState& state() const { return states.reading(); }
+	// render thread, the objects of state() are on the gpu, later states can leave out what changed up to it
+	void markSynced(uint64_t version) { synced.store(version, std::memory_order_release); }
+};
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <bit>
+#include <span>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <glm/glm.hpp>
+
+// unsigned type with the same size as T, what T goes through on the way to bytes
+template <size_t N> struct SizedUint;
+template <> struct SizedUint<1> { using type = uint8_t; };
+template <> struct SizedUint<2> { using type = uint16_t; };
+template <> struct SizedUint<4> { using type = uint32_t; };
+template <> struct SizedUint<8> { using type = uint64_t; };
+
+template <class T>
+using ByteBits = typename SizedUint<sizeof(T)>::type;
+
+// little endian no matter the host, floats go through their bit patterns
+class ByteWriter {
+public:
+	std::vector<uint8_t> bytes;
+
+	template <class T> requires std::is_integral_v<T> || std::is_enum_v<T>
+	void put(T value) {
+		using U = ByteBits<T>;
+		U bits = (U) value;
+		for (size_t i = 0; i < sizeof(U); ++i) {
+			bytes.push_back((uint8_t) (bits >> (8 * i)));
+		}
+	}
+
+	void put(bool value) { put((uint8_t) value); }
+	void put(float value) { put(std::bit_cast<uint32_t>(value)); }
+	void put(double value) { put(std::bit_cast<uint64_t>(value)); }
+	void put(glm::vec2 value) { put(value.x); put(value.y); }
+	void put(glm::vec3 value) { put(value.x); put(value.y); put(value.z); }
+
+	// 7 bits a byte, low first, small numbers take one byte
+	void putVarint(uint64_t value) {
+		while (value >= 0x80) {
+			bytes.push_back((uint8_t) (value | 0x80));
+			value >>= 7;
+		}
+		bytes.push_back((uint8_t) value);
+	}
+
+	// zigzag so small negatives stay small
+	void putSigned(int64_t value) {
+		putVarint(((uint64_t) value << 1) ^ (uint64_t) (value >> 63));
+	}
+
+	// resize and memcpy, gcc 12 sees a region of size 0 in the inlined insert and warns
+	void putBytes(std::span<const uint8_t> data) {
+		if (data.empty()) return;
+		size_t at = bytes.size();
+		bytes.resize(at + data.size());
+		std::memcpy(bytes.data() + at, data.data(), data.size());
+	}
+
+	// a whole array in one copy, element by element only on big endian hosts
+	template <class T> requires std::is_arithmetic_v<T>
+	void putArray(std::span<const T> values) {
+		if constexpr (std::endian::native == std::endian::little) {
+			putBytes({ (const uint8_t*) values.data(), values.size_bytes() });
+		} else {
+			for (T value : values) put(std::bit_cast<ByteBits<T>>(value));
+		}
+	}
+
+	// pads with zeros until the size is a multiple of alignment
+	void align(size_t alignment) {
+		while (bytes.size() % alignment != 0) bytes.push_back(0);
+	}
+
+	[[nodiscard]] size_t size() const { return bytes.size(); }
+	void clear() { bytes.clear(); }
+};
+
+// reads what ByteWriter wrote, running off the end sets failed and returns zeros from then on instead of throwing
+class ByteReader {
+private:
+	std::span<const uint8_t> data;
+	size_t pos;
+	bool bad;
+
+public:
+	ByteReader(std::span<const uint8_t> data) : data(data), pos(0), bad(false) {}
+
+	template <class T> requires std::is_integral_v<T> || std::is_enum_v<T>
+	T get() {
+		using U = ByteBits<T>;
+		if (!has(sizeof(U))) return T();
+
+		U bits = 0;
+		for (size_t i = 0; i < sizeof(U); ++i) {
+			bits |= (U) ((U) data[pos + i] << (8 * i));
+		}
+		pos += sizeof(U);
+		return (T) bits;
+	}
+
+	bool getBool() { return get<uint8_t>() != 0; }
+	float getFloat() { return std::bit_cast<float>(get<uint32_t>()); }
+	double getDouble() { return std::bit_cast<double>(get<uint64_t>()); }
+	glm::vec2 getVec2() { float x = getFloat(); return glm::vec2(x, getFloat()); }
+	glm::vec3 getVec3() { float x = getFloat(); float y = getFloat(); return glm::vec3(x, y, getFloat()); }
+
+	uint64_t getVarint() {
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			if (!has(1)) return 0;
+
+			uint8_t byte = data[pos++];
+			value |= (uint64_t) (byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0) return value;
+		}
+		bad = true;
+		return 0;
+	}
+
+	int64_t getSigned() {
+		uint64_t value = getVarint();
+		return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+	}
+
+	// view into the underlying data, no copy
+	std::span<const uint8_t> getBytes(size_t count) {
+		if (!has(count)) return {};
+
+		auto out = data.subspan(pos, count);
+		pos += count;
+		return out;
+	}
+
+	// count elements of what putArray wrote into out, one copy on little endian hosts
+	template <class T> requires std::is_arithmetic_v<T>
+	bool getArray(std::vector<T>& out, size_t count) {
+		auto raw = getBytes(count > SIZE_MAX / sizeof(T) ? SIZE_MAX : count * sizeof(T));
+		if (bad) return false;
+
+		if constexpr (std::endian::native == std::endian::little) {
+			out.resize(count);
+			if (count > 0) std::memcpy(out.data(), raw.data(), raw.size());
+		} else {
+			ByteReader in(raw);
+			out.clear();
+			out.reserve(count);
+			for (size_t i = 0; i < count; ++i) out.push_back(std::bit_cast<T>(in.get<ByteBits<T>>()));
+		}
+		return true;
+	}
+
+	void align(size_t alignment) {
+		size_t padding = (alignment - pos % alignment) % alignment;
+		getBytes(padding);
+	}
+
+	[[nodiscard]] bool has(size_t count) {
+		if (bad || data.size() - pos < count) {
+			bad = true;
+			return false;
+		}
+		return true;
+	}
+
+	[[nodiscard]] bool failed() const { return bad; }
+	[[nodiscard]] bool atEnd() const { return pos == data.size(); }
+	[[nodiscard]] size_t position() const { return pos; }
+	[[nodiscard]] size_t remaining() const { return bad ? 0 : data.size() - pos; }
+	// an earlier failure doesn't stick, reading from anywhere in range starts over
+	void seek(size_t position) { pos = position; bad = position > data.size(); }
+	[[nodiscard]] std::span<const uint8_t> span() const { return data; }
+};
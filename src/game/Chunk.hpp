@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "SpatialGrid.hpp"
+#include "OccupancyMap.hpp"
+
+// a cube of the arena that's only in memory while a snake is near it
+// foods sit on the lattice cells strictly inside the cube, so foods of neighbouring chunks can never touch
+struct Chunk {
+	static constexpr int size = 32;
+	static_assert(size == SpatialGrid::extent && size == 2 * OccupancyMap::extent + 2);
+
+	glm::ivec3 coord;
+	// indices into World::objects holding this chunk's foods
+	std::vector<uint32_t> slots;
+	SpatialGrid grid;
+	OccupancyMap occupancy;
+	// changed since it was generated, evicting it has to keep its foods
+	bool dirty;
+
+	explicit Chunk(glm::ivec3 coord) : coord(coord), slots(), grid(origin(coord)), occupancy(), dirty(false) {}
+
+	// empties the chunk and moves it to coord, keeps the memory so loading doesn't have to fault fresh pages in
+	void reset(glm::ivec3 coord) {
+		this->coord = coord;
+		slots.clear();
+		grid.reset(origin(coord));
+		occupancy.clear();
+		dirty = false;
+	}
+
+	[[nodiscard]]
+	static glm::vec3 origin(glm::ivec3 coord) {
+		return glm::vec3(coord * size);
+	}
+
+	[[nodiscard]]
+	static glm::ivec3 coordOf(glm::vec3 pos) {
+		return glm::ivec3(glm::floor(pos / (float) size));
+	}
+
+	// 21 bits an axis, plenty for any arena a float position can address
+	[[nodiscard]]
+	static uint64_t key(glm::ivec3 coord) {
+		constexpr uint64_t mask = (1ull << 21) - 1;
+		return ((uint64_t) coord.x & mask) | (((uint64_t) coord.y & mask) << 21) | (((uint64_t) coord.z & mask) << 42);
+	}
+
+	[[nodiscard]]
+	static glm::ivec3 unkey(uint64_t key) {
+		// the 21 bits of an axis to the top and back down again, so the sign comes along
+		auto axis = [&](int shift) { return (int) ((int64_t) (key >> shift << 43) >> 43); };
+		return glm::ivec3(axis(0), axis(21), axis(42));
+	}
+
+	// gap between the cubes of two chunks, 0 if they touch
+	[[nodiscard]]
+	static float distance(glm::ivec3 a, glm::ivec3 b) {
+		glm::ivec3 gap = glm::max(glm::abs(a - b) - 1, 0);
+		return glm::length(glm::vec3(gap * size));
+	}
+
+	[[nodiscard]]
+	glm::vec3 center() const {
+		return origin(coord) + (float) (size / 2);
+	}
+
+	[[nodiscard]]
+	size_t cellOf(glm::vec3 pos) const {
+		return OccupancyMap::cellOf(pos - center());
+	}
+
+	[[nodiscard]]
+	glm::vec3 posOf(size_t cell) const {
+		return center() + OccupancyMap::posOf(cell);
+	}
+};
@@ -0,0 +1,248 @@
+#include "FoodStore.hpp"
+#include <bit>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FOOD_STORE_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// gcc and clang only emit avx2 instructions inside functions that ask for them, msvc always can
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE2
+#define TARGET_AVX2
+#endif
+
+namespace {
+	struct Lanes {
+		const float* x;
+		const float* y;
+		const float* z;
+		const float* radius;
+		const uint8_t* type;
+	};
+
+	// writes up to maxHits indices in [begin, end) overlapping obj to out and returns how many it wrote
+	using HitKernel = size_t(*)(const Lanes& l, size_t begin, size_t end, Object obj, size_t skip, uint32_t* out, size_t maxHits);
+
+	size_t hitsScalar(const Lanes& l, size_t begin, size_t end, Object obj, size_t skip, uint32_t* out, size_t maxHits) {
+		size_t hits = 0;
+		for (size_t i = begin; i < end; ++i) {
+			float dx = l.x[i] - obj.pos.x;
+			float dy = l.y[i] - obj.pos.y;
+			float dz = l.z[i] - obj.pos.z;
+			float reach = l.radius[i] + obj.radius;
+
+			// same as Object::dist <= 0 without the sqrt
+			if (dx * dx + dy * dy + dz * dz <= reach * reach && l.type[i] != (uint8_t) Item::None && i != skip) {
+				out[hits++] = (uint32_t) i;
+				if (hits == maxHits) break;
+			}
+		}
+		return hits;
+	}
+
+#ifdef FOOD_STORE_X86
+	TARGET_SSE2
+	size_t hitsSSE2(const Lanes& l, size_t begin, size_t end, Object obj, size_t skip, uint32_t* out, size_t maxHits) {
+		const __m128 px = _mm_set1_ps(obj.pos.x);
+		const __m128 py = _mm_set1_ps(obj.pos.y);
+		const __m128 pz = _mm_set1_ps(obj.pos.z);
+		const __m128 pr = _mm_set1_ps(obj.radius);
+		const __m128i none = _mm_set1_epi32((int) Item::None);
+		const __m128i zero = _mm_setzero_si128();
+
+		size_t hits = 0;
+		size_t i = begin;
+		for (; i + 4 <= end; i += 4) {
+			__m128 dx = _mm_sub_ps(_mm_loadu_ps(l.x + i), px);
+			__m128 dy = _mm_sub_ps(_mm_loadu_ps(l.y + i), py);
+			__m128 dz = _mm_sub_ps(_mm_loadu_ps(l.z + i), pz);
+			__m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+			__m128 reach = _mm_add_ps(_mm_loadu_ps(l.radius + i), pr);
+			__m128 hit = _mm_cmple_ps(d2, _mm_mul_ps(reach, reach));
+
+			// widen the 4 type bytes to 32 bit lanes
+			int packed;
+			memcpy(&packed, l.type + i, sizeof(packed));
+			__m128i types = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+			__m128 dead = _mm_castsi128_ps(_mm_cmpeq_epi32(types, none));
+
+			unsigned mask = (unsigned) _mm_movemask_ps(_mm_andnot_ps(dead, hit));
+			while (mask != 0) {
+				size_t index = i + std::countr_zero(mask);
+				mask &= mask - 1;
+				if (index == skip) continue;
+
+				out[hits++] = (uint32_t) index;
+				if (hits == maxHits) return hits;
+			}
+		}
+		return hits + hitsScalar(l, i, end, obj, skip, out + hits, maxHits - hits);
+	}
+
+	TARGET_AVX2
+	size_t hitsAVX2(const Lanes& l, size_t begin, size_t end, Object obj, size_t skip, uint32_t* out, size_t maxHits) {
+		const __m256 px = _mm256_set1_ps(obj.pos.x);
+		const __m256 py = _mm256_set1_ps(obj.pos.y);
+		const __m256 pz = _mm256_set1_ps(obj.pos.z);
+		const __m256 pr = _mm256_set1_ps(obj.radius);
+		const __m256i none = _mm256_set1_epi32((int) Item::None);
+
+		size_t hits = 0;
+		size_t i = begin;
+		for (; i + 8 <= end; i += 8) {
+			__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(l.x + i), px);
+			__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(l.y + i), py);
+			__m256 dz = _mm256_sub_ps(_mm256_loadu_ps(l.z + i), pz);
+			__m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+			__m256 reach = _mm256_add_ps(_mm256_loadu_ps(l.radius + i), pr);
+			__m256 hit = _mm256_cmp_ps(d2, _mm256_mul_ps(reach, reach), _CMP_LE_OQ);
+
+			__m256i types = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) (l.type + i)));
+			__m256 dead = _mm256_castsi256_ps(_mm256_cmpeq_epi32(types, none));
+
+			unsigned mask = (unsigned) _mm256_movemask_ps(_mm256_andnot_ps(dead, hit));
+			while (mask != 0) {
+				size_t index = i + std::countr_zero(mask);
+				mask &= mask - 1;
+				if (index == skip) continue;
+
+				out[hits++] = (uint32_t) index;
+				if (hits == maxHits) {
+					_mm256_zeroupper();
+					return hits;
+				}
+			}
+		}
+		// gcc skips vzeroupper before the scalar call, dirty upper halves slow down all later sse code
+		_mm256_zeroupper();
+		return hits + hitsScalar(l, i, end, obj, skip, out + hits, maxHits - hits);
+	}
+#endif
+
+	bool cpuHasAVX2() {
+#if defined(FOOD_STORE_X86) && defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) return false;
+
+		// the os also has to save the ymm registers
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#elif defined(FOOD_STORE_X86)
+		return __builtin_cpu_supports("avx2");
+#else
+		return false;
+#endif
+	}
+
+	HitKernel kernelFor(FoodStore::Kernel k) {
+		switch (k) {
+#ifdef FOOD_STORE_X86
+		case FoodStore::Kernel::AVX2:
+			return hitsAVX2;
+		case FoodStore::Kernel::SSE2:
+			return hitsSSE2;
+#endif
+		default:
+			return hitsScalar;
+		}
+	}
+
+	FoodStore::Kernel bestKernel() {
+		if (FoodStore::supports(FoodStore::Kernel::AVX2)) return FoodStore::Kernel::AVX2;
+		if (FoodStore::supports(FoodStore::Kernel::SSE2)) return FoodStore::Kernel::SSE2;
+		return FoodStore::Kernel::Scalar;
+	}
+
+	FoodStore::Kernel& currentKernel() {
+		static FoodStore::Kernel k = bestKernel();
+		return k;
+	}
+
+	Lanes lanesOf(const FoodStore& store) {
+		return { store.x.data(), store.y.data(), store.z.data(), store.radius.data(), store.type.data() };
+	}
+}
+
+void FoodStore::push(const ItemObj& obj) {
+	x.push_back(obj.pos.x);
+	y.push_back(obj.pos.y);
+	z.push_back(obj.pos.z);
+	radius.push_back(obj.radius);
+	type.push_back((uint8_t) obj.item);
+}
+
+void FoodStore::set(size_t index, const ItemObj& obj) {
+	x[index] = obj.pos.x;
+	y[index] = obj.pos.y;
+	z[index] = obj.pos.z;
+	radius[index] = obj.radius;
+	type[index] = (uint8_t) obj.item;
+}
+
+void FoodStore::clear() {
+	x.clear();
+	y.clear();
+	z.clear();
+	radius.clear();
+	type.clear();
+}
+
+size_t FoodStore::firstHit(Object obj, size_t skip) const {
+	uint32_t hit;
+	size_t hits = kernelFor(currentKernel())(lanesOf(*this), 0, size(), obj, skip, &hit, 1);
+	return hits > 0 ? hit : npos;
+}
+
+void FoodStore::allHits(Object obj, std::vector<uint32_t>& out, size_t skip) const {
+	constexpr size_t block = 1024;
+	uint32_t hits[block];
+
+	HitKernel hitKernel = kernelFor(currentKernel());
+	Lanes l = lanesOf(*this);
+	for (size_t begin = 0; begin < size(); begin += block) {
+		size_t end = begin + block < size() ? begin + block : size();
+		size_t count = hitKernel(l, begin, end, obj, skip, hits, block);
+		out.insert(out.end(), hits, hits + count);
+	}
+}
+
+bool FoodStore::supports(Kernel k) {
+	switch (k) {
+	case Kernel::Scalar:
+		return true;
+#ifdef FOOD_STORE_X86
+	case Kernel::SSE2:
+		// part of x86-64, and every 32 bit cpu still around
+		return true;
+	case Kernel::AVX2:
+		return cpuHasAVX2();
+#endif
+	default:
+		return false;
+	}
+}
+
+bool FoodStore::useKernel(Kernel k) {
+	if (!supports(k)) return false;
+
+	currentKernel() = k;
+	return true;
+}
+
+FoodStore::Kernel FoodStore::kernel() {
+	return currentKernel();
+}
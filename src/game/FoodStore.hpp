@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "Object.hpp"
+
+// structure-of-arrays copy of World::objects so sphere tests can run over whole lanes at once
+class FoodStore {
+public:
+	enum class Kernel {
+		Scalar,
+		SSE2,
+		AVX2,
+	};
+
+	static constexpr size_t npos = SIZE_MAX;
+
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> z;
+	std::vector<float> radius;
+	std::vector<uint8_t> type;
+
+	[[nodiscard]] size_t size() const { return x.size(); }
+
+	void push(const ItemObj& obj);
+	void set(size_t index, const ItemObj& obj);
+	void clear();
+
+	// index of the first object overlapping obj, npos if there is none
+	// skip is an index to ignore, None items never hit
+	[[nodiscard]]
+	size_t firstHit(Object obj, size_t skip = npos) const;
+
+	// appends the index of every object overlapping obj to out
+	void allHits(Object obj, std::vector<uint32_t>& out, size_t skip = npos) const;
+
+	// the best kernel the cpu supports is picked on first use, this overrides it
+	// returns false and keeps the current kernel if k isn't supported
+	static bool useKernel(Kernel k);
+	[[nodiscard]] static Kernel kernel();
+	[[nodiscard]] static bool supports(Kernel k);
+};
@@ -1,7 +1,13 @@
 #pragma once
 
+#include <vector>
+#include <algorithm>
+
 #include "World.hpp"
 #include "Snake.hpp"
+#include "SimClock.hpp"
+#include "SnakeSweep.hpp"
+#include "../Profiler.hpp"
 
 enum class State {
 	Waiting,
@@ -9,35 +15,173 @@ enum class State {
 	Overing,
 };
 
+// every snake in a game as one collider, for keeping food off all of them
+struct SnakeSet {
+	const std::vector<Snake>& snakes;
+
+	[[nodiscard]]
+	bool collides(Object obj) const {
+		for (const auto& snake : snakes) {
+			if (snake.collides(obj)) return true;
+		}
+		return false;
+	}
+};
+
 struct Game {
-	Snake player;
+	// snakes[0] is the player, the rest are whoever else is in the arena
+	std::vector<Snake> snakes;
+	// why each snake is out, None while it's still going, out snakes stay where they died
+	std::vector<LoseCode> lost;
 	World world;
-	long double timeElapsed;
+	// double rather than long double so a snapshot restores it bit for bit on every compiler
+	double timeElapsed;
 	State state;
+	SimClock clock;
+	// ticks run since the game was created, restarts don't reset it, replays count on it
+	uint64_t ticks = 0;
+	// workers for the move phase, 0 uses every hardware thread
+	unsigned threads = 0;
+	// snake vs snake broadphase, kept between ticks so its sort stays warm
+	SnakeSweep sweep;
+	// scratch for tick, one per snake
+	std::vector<TickResult> results;
+	std::vector<uint8_t> bitten;
+	// where each snake's head starts the tick, what the world streams chunks around
+	std::vector<glm::vec3> heads;
+
+	// below this many snakes per worker, starting threads costs more than it saves
+	static constexpr size_t snakesPerThread = 64;
+
+
+	Game() : snakes(1), lost(1, LoseCode::None), world(), timeElapsed(0.0), state(State::Waiting), clock() {};
+
+	Snake& player() {
+		return this->snakes[0];
+	}
 
+	const Snake& player() const {
+		return this->snakes[0];
+	}
+
+	[[nodiscard]]
+	SnakeSet snakeSet() const {
+		return { this->snakes };
+	}
 
-	Game() : player(), world(), timeElapsed(0.0), state(State::Waiting) {};
+	// returns the new snake's index
+	size_t addSnake(Snake snake) {
+		this->snakes.push_back(std::move(snake));
+		this->lost.push_back(LoseCode::None);
+		return this->snakes.size() - 1;
+	}
+
+	// puts snake i back in the game, e.g. the player after a restart
+	void respawn(size_t i, Snake snake = Snake()) {
+		this->snakes[i] = std::move(snake);
+		this->lost[i] = LoseCode::None;
+	}
+
+	// feeds a frame's worth of real time to the clock and runs the fixed ticks it covers, returns how many ran
+	// render with clock.alpha() to land between the last two ticks
+	int update(double frameDt) {
+		int steps = this->clock.advance(frameDt);
+		for (int i = 0; i < steps; ++i) {
+			fixedTick();
+		}
+		return steps;
+	}
+
+	// one tick of clock.step, what update runs and what replays run
+	void fixedTick() {
+		for (auto& snake : this->snakes) {
+			snake.savePrevious();
+		}
+		tick(this->clock.step);
+	}
+
+	// replaces all food with a layout that only depends on seed and the snakes, see World::generate
+	// foods is the total for the whole arena, only the part near the snakes is made right away
+	size_t generate(uint64_t seed, uint64_t foods, unsigned threads = 0) {
+		collectHeads();
+		return this->world.generate(seed, foods, this->heads, snakeSet(), threads);
+	}
+
+	void collectHeads() {
+		this->heads.clear();
+		for (const auto& snake : this->snakes) {
+			this->heads.push_back(snake.moveStart());
+		}
+	}
 
 	void placeFood(int n = 1) {
 		for (int i = 0; i < n; ++i) {
-			this->world.placeFood(this->player);
+			if (!this->world.placeFood(snakeSet())) break;
+		}
+	}
+
+	// moves every snake still in the game by dt
+	// the snakes move in parallel against a world nobody writes to, heads are checked against every other snake
+	// once all of them have moved, then whatever they ran into is handed out in snake order, so a food two heads
+	// reach on the same tick goes to the lower index and the result never depends on thread count or timing
+	void step(double dt) {
+		size_t count = this->snakes.size();
+		this->results.resize(count);
+
+		// everything a head can reach this tick is within the chunks around it
+		collectHeads();
+		{
+			ProfileScope scope("stream");
+			this->world.stream(this->heads, snakeSet(), this->threads);
+		}
+
+		unsigned workers = this->threads == 0 ? defaultThreads() : this->threads;
+		workers = (unsigned) std::min<size_t>(workers, (count + snakesPerThread - 1) / snakesPerThread);
+
+		parallelFor(count, workers, [&](size_t begin, size_t end) {
+			ProfileScope scope("move");
+			for (size_t i = begin; i < end; ++i) {
+				if (this->lost[i] != LoseCode::None) {
+					this->results[i].clear();
+					continue;
+				}
+				this->snakes[i].move((float) dt, this->world, this->results[i]);
+			}
+		});
+
+		// snakes that just hit a wall or themselves don't count as obstacles, they're gone
+		auto alive = [&](size_t i) { return this->lost[i] == LoseCode::None && this->results[i].lose == LoseCode::None; };
+		this->sweep.update(this->snakes, alive);
+		this->sweep.bitten(this->snakes, this->bitten);
+		for (size_t i = 0; i < count; ++i) {
+			// head on, both of them lose
+			if (this->bitten[i]) this->results[i].lose = LoseCode::Bitten;
+		}
+
+		for (size_t i = 0; i < count; ++i) {
+			const auto& result = this->results[i];
+			if (result.lose != LoseCode::None) {
+				this->lost[i] = result.lose;
+			} else {
+				for (const auto& food : result.foods) {
+					this->snakes[i].eat(this->world, food.index, snakeSet());
+				}
+			}
 		}
 	}
 
 	void tick(double dt) {
+		ProfileScope scope("Game::tick");
+		this->ticks++;
 		switch (this->state) {
 		case State::Waiting:
-			// give 1 second so stuff has a chance to load
-			this->timeElapsed += dt;
-			if (this->timeElapsed >= 1.0) {
-				this->state = State::Playing;
-				this->timeElapsed = 0.0f;
-			}
+			// until whoever runs the game has loaded what it needs and sets Playing, e.g. the window once its programs link
 			break;
 		case State::Playing:
 			this->timeElapsed += dt;
+			step(dt);
 			// if they didn't lose
-			if (this->player.tick(dt, this->world) != LoseCode::None)
+			if (this->lost[0] != LoseCode::None)
 				this->state = State::Overing;
 			break;
 		case State::Overing:
@@ -49,6 +193,6 @@ struct Game {
 	}
 
 	int getScore() const {
-		return (int)timeElapsed + player.foodsEaten;
+		return (int)timeElapsed + player().foodsEaten;
 	}
-};
\ No newline at end of file
+};
@@ -0,0 +1,133 @@
+#include "MappedFile.hpp"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile() : data(nullptr), length(0), opened(false), file(INVALID_HANDLE_VALUE), mapping(nullptr) {}
+#else
+MappedFile::MappedFile() : data(nullptr), length(0), opened(false) {}
+#endif
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept : MappedFile() {
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+	if (this != &other) {
+		close();
+		data = std::exchange(other.data, nullptr);
+		length = std::exchange(other.length, 0);
+		opened = std::exchange(other.opened, false);
+#ifdef _WIN32
+		file = std::exchange(other.file, INVALID_HANDLE_VALUE);
+		mapping = std::exchange(other.mapping, nullptr);
+#endif
+	}
+	return *this;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path) {
+	close();
+
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size)) {
+		close();
+		return false;
+	}
+	length = (size_t) size.QuadPart;
+	opened = true;
+
+	// windows can't map an empty file, there's nothing to look at anyway
+	if (length == 0) return true;
+
+	mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		close();
+		return false;
+	}
+
+	data = (const uint8_t*) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::close() {
+	if (data != nullptr) UnmapViewOfFile(data);
+	if (mapping != nullptr) CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+
+	data = nullptr;
+	length = 0;
+	opened = false;
+	mapping = nullptr;
+	file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path) {
+	close();
+
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		::close(fd);
+		return false;
+	}
+	length = (size_t) info.st_size;
+	opened = true;
+
+	if (length == 0) {
+		::close(fd);
+		return true;
+	}
+
+	void* view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping keeps the file alive on its own
+	::close(fd);
+	if (view == MAP_FAILED) {
+		length = 0;
+		opened = false;
+		return false;
+	}
+
+	// replays and snapshots are read front to back
+	madvise(view, length, MADV_SEQUENTIAL);
+	data = (const uint8_t*) view;
+	return true;
+}
+
+void MappedFile::close() {
+	if (data != nullptr) munmap((void*) data, length);
+
+	data = nullptr;
+	length = 0;
+	opened = false;
+}
+
+#endif
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <cstdint>
+
+// read only view of a whole file through the OS page cache, nothing is read until it's touched
+class MappedFile {
+private:
+	const uint8_t* data;
+	size_t length;
+	bool opened;
+#ifdef _WIN32
+	void* file;
+	void* mapping;
+#endif
+
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	// false if the file can't be opened or mapped, an empty file is fine and maps to an empty span
+	bool open(const std::string& path);
+	void close();
+
+	[[nodiscard]] bool isOpen() const { return opened; }
+	[[nodiscard]] std::span<const uint8_t> bytes() const { return { data, length }; }
+};
@@ -0,0 +1,252 @@
+#pragma once
+
+#include <bit>
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "Parallel.hpp"
+
+class ByteWriter;
+class ByteReader;
+struct World;
+
+// bitmaps over the integer lattice foods are placed on inside one chunk, cells are relative to the chunk's center
+// a cell is free when neither it nor any of its 6 neighbours holds a food, which is exactly where a new 0.5 radius food fits
+// free cells are counted per 64 bit word in a fenwick tree, so picking the n-th free cell is O(log words)
+class OccupancyMap {
+	// game images copy the internals as they are, see Snapshot.hpp
+	friend void writeWorldImage(ByteWriter& out, const World& world);
+	friend bool readWorldImage(ByteReader& in, World& world);
+
+public:
+	// the chunk is 32 wide, its faces are left out so foods of neighbouring chunks never touch
+	static constexpr int extent = 15;
+	static constexpr int side = 2 * extent + 1;
+	static constexpr size_t cellCount = (size_t) side * side * side;
+	static constexpr size_t wordCount = (cellCount + 63) / 64;
+	static constexpr size_t npos = SIZE_MAX;
+
+private:
+	std::vector<uint64_t> occupied;
+	std::vector<uint64_t> freeBits;
+	// 1 based, tree[i] covers the free counts of words (i - lowbit(i), i]
+	std::vector<uint32_t> tree;
+	size_t freeCells;
+
+	[[nodiscard]] bool test(const std::vector<uint64_t>& bits, size_t cell) const {
+		return (bits[cell >> 6] >> (cell & 63)) & 1;
+	}
+
+	void addCount(size_t word, int32_t delta) {
+		for (size_t i = word + 1; i <= wordCount; i += i & (~i + 1)) {
+			tree[i] += delta;
+		}
+	}
+
+	void setFree(size_t cell, bool free) {
+		uint64_t bit = 1ull << (cell & 63);
+		uint64_t& word = freeBits[cell >> 6];
+		if (((word & bit) != 0) == free) return;
+
+		word ^= bit;
+		addCount(cell >> 6, free ? 1 : -1);
+		freeCells += free ? 1 : -1;
+	}
+
+	// 64 occupied bits starting at cell start, anything outside the map reads as empty
+	[[nodiscard]] uint64_t occupiedAt(int64_t start) const {
+		int64_t word = start >> 6;
+		int shift = (int) (start & 63);
+
+		uint64_t lo = word >= 0 && word < (int64_t) wordCount ? occupied[word] : 0;
+		if (shift == 0) return lo;
+
+		uint64_t hi = word + 1 >= 0 && word + 1 < (int64_t) wordCount ? occupied[word + 1] : 0;
+		return (lo >> shift) | (hi << (64 - shift));
+	}
+
+	// free bits of a whole word straight from the occupied bitmap
+	[[nodiscard]] uint64_t freeWord(size_t word) const {
+		constexpr int64_t row = side;
+		constexpr int64_t slice = (int64_t) side * side;
+
+		// cells on the low/high x and y faces, their neighbour in that direction wraps into another row or slice
+		uint64_t xLo = 0, xHi = 0, yLo = 0, yHi = 0;
+		size_t first = word * 64;
+		size_t x = first % side;
+		size_t y = (first / side) % side;
+		for (int i = 0; i < 64; ++i) {
+			uint64_t bit = 1ull << i;
+			if (x == 0) xLo |= bit;
+			if (x == side - 1) xHi |= bit;
+			if (y == 0) yLo |= bit;
+			if (y == side - 1) yHi |= bit;
+
+			if (++x == side) {
+				x = 0;
+				if (++y == side) y = 0;
+			}
+		}
+
+		int64_t base = (int64_t) first;
+		uint64_t blockedBits = occupiedAt(base)
+			| (occupiedAt(base - 1) & ~xLo) | (occupiedAt(base + 1) & ~xHi)
+			| (occupiedAt(base - row) & ~yLo) | (occupiedAt(base + row) & ~yHi)
+			| occupiedAt(base - slice) | occupiedAt(base + slice);
+
+		uint64_t valid = first + 64 <= cellCount ? ~0ull : (1ull << (cellCount - first)) - 1;
+		return ~blockedBits & valid;
+	}
+
+	[[nodiscard]] bool blocked(size_t cell) const {
+		if (test(occupied, cell)) return true;
+
+		bool hit = false;
+		forNeighbours(cell, [&](size_t n) { hit = hit || test(occupied, n); });
+		return hit;
+	}
+
+public:
+	// calls f(neighbour) for each in-bounds face neighbour
+	template <class F>
+	static void forNeighbours(size_t cell, F&& f) {
+		size_t x = cell % side;
+		size_t y = (cell / side) % side;
+		size_t z = cell / ((size_t) side * side);
+
+		if (x > 0) f(cell - 1);
+		if (x < side - 1) f(cell + 1);
+		if (y > 0) f(cell - side);
+		if (y < side - 1) f(cell + side);
+		if (z > 0) f(cell - (size_t) side * side);
+		if (z < side - 1) f(cell + (size_t) side * side);
+	}
+
+	OccupancyMap() : occupied(wordCount), freeBits(wordCount), tree(wordCount + 1), freeCells(0) {
+		clear();
+	}
+
+	[[nodiscard]]
+	static size_t cellOf(glm::vec3 pos) {
+		glm::ivec3 c = glm::ivec3(glm::round(pos)) + extent;
+		if (c.x < 0 || c.y < 0 || c.z < 0 || c.x >= side || c.y >= side || c.z >= side) return npos;
+
+		return ((size_t) c.z * side + c.y) * side + c.x;
+	}
+
+	[[nodiscard]]
+	static glm::vec3 posOf(size_t cell) {
+		return glm::vec3(
+			(int) (cell % side) - extent,
+			(int) ((cell / side) % side) - extent,
+			(int) (cell / ((size_t) side * side)) - extent
+		);
+	}
+
+	[[nodiscard]] size_t freeCount() const { return freeCells; }
+	[[nodiscard]] bool isFree(size_t cell) const { return test(freeBits, cell); }
+
+	void occupy(size_t cell) {
+		if (cell == npos) return;
+
+		occupied[cell >> 6] |= 1ull << (cell & 63);
+		setFree(cell, false);
+		forNeighbours(cell, [&](size_t n) { setFree(n, false); });
+	}
+
+	void release(size_t cell) {
+		if (cell == npos) return;
+
+		occupied[cell >> 6] &= ~(1ull << (cell & 63));
+		setFree(cell, !blocked(cell));
+		forNeighbours(cell, [&](size_t n) { setFree(n, !blocked(n)); });
+	}
+
+	// the rank-th free cell in index order, rank must be below freeCount()
+	[[nodiscard]]
+	size_t selectFree(size_t rank) const {
+		size_t word = 0;
+		for (size_t step = std::bit_floor(wordCount); step > 0; step >>= 1) {
+			if (word + step <= wordCount && tree[word + step] <= rank) {
+				word += step;
+				rank -= tree[word];
+			}
+		}
+
+		// skip whole bytes first, then at most 7 bits
+		uint64_t bits = freeBits[word];
+		size_t base = word * 64;
+		for (;;) {
+			size_t count = (size_t) std::popcount(bits & 0xFF);
+			if (rank < count) break;
+
+			rank -= count;
+			bits >>= 8;
+			base += 8;
+		}
+		for (size_t i = 0; i < rank; ++i) {
+			bits &= bits - 1;
+		}
+		return base + std::countr_zero(bits);
+	}
+
+	// next free cell at or after cell, wrapping around, npos if the arena is full
+	[[nodiscard]]
+	size_t nextFree(size_t cell) const {
+		if (freeCells == 0) return npos;
+
+		size_t word = cell >> 6;
+		uint64_t bits = freeBits[word] & (~0ull << (cell & 63));
+		while (bits == 0) {
+			word = (word + 1) % wordCount;
+			bits = freeBits[word];
+		}
+		return word * 64 + std::countr_zero(bits);
+	}
+
+	// occupies every cell in cells, big batches rebuild the free bitmap word by word across threads
+	void occupyAll(const std::vector<size_t>& cells, unsigned threads = 0) {
+		// each single occupy touches ~100 tree nodes, past this point one pass over the whole map is cheaper
+		if (cells.size() < cellCount / 128) {
+			for (size_t cell : cells) occupy(cell);
+			return;
+		}
+
+		for (size_t cell : cells) {
+			if (cell != npos) occupied[cell >> 6] |= 1ull << (cell & 63);
+		}
+
+		// words don't straddle threads, so no two threads write the same word
+		parallelFor(wordCount, threads, [&](size_t begin, size_t end) {
+			for (size_t word = begin; word < end; ++word) {
+				freeBits[word] = freeWord(word);
+			}
+		});
+
+		rebuildTree();
+	}
+
+	void clear() {
+		std::fill(occupied.begin(), occupied.end(), 0);
+		std::fill(freeBits.begin(), freeBits.end(), ~0ull);
+		// the padding past the last cell is never free
+		if (cellCount % 64 != 0) freeBits.back() = (1ull << (cellCount % 64)) - 1;
+
+		rebuildTree();
+	}
+
+private:
+	// linear fenwick build from freeBits
+	void rebuildTree() {
+		std::fill(tree.begin(), tree.end(), 0);
+		freeCells = 0;
+		for (size_t i = 1; i <= wordCount; ++i) {
+			uint32_t count = (uint32_t) std::popcount(freeBits[i - 1]);
+			freeCells += count;
+			tree[i] += count;
+			size_t parent = i + (i & (~i + 1));
+			if (parent <= wordCount) tree[parent] += tree[i];
+		}
+	}
+};
@@ -0,0 +1,81 @@
+#include "Parallel.hpp"
+
+#include <string>
+
+#include "../Profiler.hpp"
+
+WorkerPool::WorkerPool(unsigned threads) {
+	// the workers' profile rings go back to the profiler as they exit, so it has to outlive the pool
+	Profiler::instance();
+	workers.reserve(threads);
+	for (unsigned t = 0; t < threads; ++t) {
+		workers.emplace_back([this, t] {
+			Profiler::instance().nameThread("worker " + std::to_string(t));
+			work();
+		});
+	}
+}
+
+WorkerPool& WorkerPool::instance() {
+	static WorkerPool pool(defaultThreads() - 1);
+	return pool;
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		std::lock_guard lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+bool WorkerPool::take(Job& job, size_t& chunk) {
+	if (job.next == job.chunks) return false;
+	chunk = job.next++;
+	return true;
+}
+
+void WorkerPool::work() {
+	std::unique_lock lock(mutex);
+	while (true) {
+		wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+		if (stopping) return;
+
+		Job& job = *jobs.front();
+		size_t chunk;
+		if (!take(job, chunk)) {
+			// all handed out, the caller will find it finished once the chunks still running are
+			jobs.erase(jobs.begin());
+			continue;
+		}
+		job.users++;
+		do {
+			lock.unlock();
+			job.call(job.context, chunk);
+			lock.lock();
+		} while (take(job, chunk));
+		if (--job.users == 0) done.notify_all();
+	}
+}
+
+void WorkerPool::run(size_t chunks, void (*call)(void* context, size_t chunk), void* context) {
+	Job job{ call, context, chunks, 0, 0 };
+	std::unique_lock lock(mutex);
+	jobs.push_back(&job);
+	wake.notify_all();
+
+	size_t chunk;
+	while (take(job, chunk)) {
+		lock.unlock();
+		call(context, chunk);
+		lock.lock();
+	}
+
+	// workers may still be inside the last chunks, and job lives on this stack
+	auto it = std::find(jobs.begin(), jobs.end(), &job);
+	if (it != jobs.end()) jobs.erase(it);
+	done.wait(lock, [&job] { return job.users == 0; });
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <condition_variable>
+
+// number of workers to use when a caller passes 0
+// hardware_concurrency is a syscall on some platforms and this gets asked every tick, so it's read once
+[[nodiscard]]
+inline unsigned defaultThreads() {
+	static const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+	return threads;
+}
+
+// threads that live as long as the program and run parallelFor's chunks, starting threads every tick costs more
+// than most of what they'd run
+// several threads may run jobs at once, e.g. the simulation and the renderer, and a chunk may start a job of its own,
+// every caller works through its own job's chunks too, so a job never waits on the pool being free
+class WorkerPool {
+private:
+	struct Job {
+		void (*call)(void* context, size_t chunk);
+		void* context;
+		size_t chunks;
+		// guarded by mutex, chunks handed out so far and workers still inside one
+		size_t next;
+		unsigned users;
+	};
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	// jobs that still have chunks to hand out, oldest first
+	std::vector<Job*> jobs;
+	std::vector<std::thread> workers;
+	bool stopping = false;
+
+	explicit WorkerPool(unsigned threads);
+	void work();
+	// the next chunk of job, false once they're all handed out, mutex held
+	bool take(Job& job, size_t& chunk);
+
+public:
+	// defaultThreads() - 1 workers, the caller of run is the last one
+	static WorkerPool& instance();
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	// call(context, chunk) for every chunk in [0, chunks), on the calling thread and any idle worker, returns when all are done
+	void run(size_t chunks, void (*call)(void* context, size_t chunk), void* context);
+};
+
+// runs f(begin, end) over contiguous chunks of [0, count), one chunk per thread, and waits for all of them
+// threads == 0 uses every hardware thread
+template <class F>
+void parallelFor(size_t count, unsigned threads, F&& f) {
+	if (count == 0) return;
+	if (threads == 0) threads = defaultThreads();
+	threads = (unsigned) std::min<size_t>(threads, count);
+
+	size_t chunk = (count + threads - 1) / threads;
+	if (chunk >= count) {
+		f(0, count);
+		return;
+	}
+
+	struct Context {
+		F& f;
+		size_t count;
+		size_t chunk;
+	} context{ f, count, chunk };
+	WorkerPool::instance().run((count + chunk - 1) / chunk, [](void* p, size_t i) {
+		Context& c = *static_cast<Context*>(p);
+		size_t begin = i * c.chunk;
+		c.f(begin, std::min(c.count, begin + c.chunk));
+	}, &context);
+}
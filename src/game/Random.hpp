@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// Philox4x32-10 from "Parallel Random Numbers: As Easy as 1, 2, 3" (Salmon et al. 2011)
+// it's a keyed hash of the counter, so any thread can draw any element of a stream without sharing state
+[[nodiscard]]
+constexpr std::array<uint32_t, 4> philox4x32(std::array<uint32_t, 4> ctr, uint64_t key) {
+	constexpr uint32_t m0 = 0xD2511F53u;
+	constexpr uint32_t m1 = 0xCD9E8D57u;
+	constexpr uint32_t w0 = 0x9E3779B9u;
+	constexpr uint32_t w1 = 0xBB67AE85u;
+
+	uint32_t k0 = (uint32_t) key;
+	uint32_t k1 = (uint32_t) (key >> 32);
+
+	for (int round = 0; round < 10; ++round) {
+		uint64_t p0 = (uint64_t) m0 * ctr[0];
+		uint64_t p1 = (uint64_t) m1 * ctr[2];
+
+		ctr = {
+			(uint32_t) (p1 >> 32) ^ ctr[1] ^ k0,
+			(uint32_t) p1,
+			(uint32_t) (p0 >> 32) ^ ctr[3] ^ k1,
+			(uint32_t) p0,
+		};
+
+		k0 += w0;
+		k1 += w1;
+	}
+
+	return ctr;
+}
+
+// element index of stream, 4 words at a time
+[[nodiscard]]
+constexpr std::array<uint32_t, 4> philoxBlock(uint64_t key, uint64_t stream, uint64_t index) {
+	return philox4x32({ (uint32_t) index, (uint32_t) (index >> 32), (uint32_t) stream, (uint32_t) (stream >> 32) }, key);
+}
+
+// maps a draw onto [0, n) with a multiply instead of a modulo, the bias is below n / 2^32
+[[nodiscard]]
+constexpr uint32_t boundedDraw(uint32_t draw, uint32_t n) {
+	return (uint32_t) (((uint64_t) draw * n) >> 32);
+}
+
+// sequential reader over one philox stream, the position is all the state there is
+class CounterRng {
+private:
+	uint64_t key;
+	uint64_t stream;
+	uint64_t pos;
+
+public:
+	CounterRng(uint64_t key = 0, uint64_t stream = 0) : key(key), stream(stream), pos(0) {}
+
+	uint32_t next() {
+		uint32_t word = philoxBlock(key, stream, pos >> 2)[pos & 3];
+		pos++;
+		return word;
+	}
+
+	// uniform in [0, n)
+	uint32_t below(uint32_t n) {
+		return boundedDraw(next(), n);
+	}
+
+	[[nodiscard]] uint64_t position() const { return pos; }
+	void seek(uint64_t position) { pos = position; }
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include "Object.hpp"
+
+// what drawing a game needs of one tick, built on the simulation thread and read only by the render thread once
+// published, so a frame never looks at a game that is halfway through a tick
+struct RenderState {
+	struct SnakePoints {
+		// into points
+		uint32_t first;
+		uint32_t count;
+		// where the head and tail were a tick before, Snake::interpolated(0.0f)
+		glm::vec3 prevHead;
+		glm::vec3 prevTail;
+	};
+
+	// the same as Snake::Interpolated, off the copied points
+	struct Interpolated {
+		const glm::vec3* points;
+		size_t count;
+		glm::vec3 head;
+		glm::vec3 tail;
+
+		[[nodiscard]] size_t size() const { return count; }
+
+		glm::vec3 operator[](size_t i) const {
+			if (i == 0) return head;
+			if (i == count - 1) return tail;
+			return points[i];
+		}
+	};
+
+	// counts up with every publish
+	uint64_t version = 0;
+	// Profiler::now() the last tick stands for, frames interpolate on from there
+	uint64_t tickTime = 0;
+	// seconds per tick
+	double step = 1.0;
+	int half = 0;
+
+	// every snake's points one after the other, snakes[0] is the player
+	std::vector<glm::vec3> points;
+	std::vector<SnakePoints> snakes;
+
+	// World::objects entries changed since the last state the renderer said it synced, ascending and each once
+	std::vector<uint32_t> changed;
+	std::vector<ItemObj> changedObjects;
+	// instead of the changes, every object, after a restart or a load
+	bool rebuilt = false;
+	std::vector<ItemObj> objects;
+	size_t objectCount = 0;
+
+	// how far now is past the tick, 0 - 1, it holds at 1 until the next state shows up
+	[[nodiscard]]
+	float alpha(uint64_t now) const {
+		if (now <= tickTime) return 0.0f;
+		return (float) glm::min((double) (now - tickTime) / 1e9 / step, 1.0);
+	}
+
+	[[nodiscard]]
+	Interpolated snake(size_t i, float alpha) const {
+		const SnakePoints& snake = snakes[i];
+		const glm::vec3* first = points.data() + snake.first;
+		if (snake.count < 2) return { first, snake.count, glm::vec3(0.0f), glm::vec3(0.0f) };
+
+		return { first, snake.count, glm::mix(snake.prevHead, first[0], alpha), glm::mix(snake.prevTail, first[snake.count - 1], alpha) };
+	}
+};
@@ -0,0 +1,319 @@
+#include "Replay.hpp"
+
+#include <bit>
+#include <cstring>
+
+#include "Snapshot.hpp"
+
+static constexpr char headerMagic[4] = { 'W', 'S', 'R', 'P' };
+static constexpr char trailerMagic[4] = { 'W', 'S', 'R', 'I' };
+static constexpr size_t headerSize = 4 + 4 + 4 + 8 + 8;
+static constexpr size_t trailerSize = 8 + 8 + 8 + 4 + 4;
+// the buffer goes to disk once it's this big
+static constexpr size_t flushSize = 1 << 16;
+
+// turns are almost always whole multiples of 90 degrees, their bits are all in the top bytes, reversed they're small
+static uint32_t reverseBytes(uint32_t v) {
+	return (v >> 24) | ((v >> 8) & 0xFF00) | ((v << 8) & 0xFF0000) | (v << 24);
+}
+
+static void putMagic(ByteWriter& out, const char (&magic)[4]) {
+	out.putBytes({ (const uint8_t*) magic, 4 });
+}
+
+static bool getMagic(ByteReader& in, const char (&magic)[4]) {
+	auto bytes = in.getBytes(4);
+	return bytes.size() == 4 && std::memcmp(bytes.data(), magic, 4) == 0;
+}
+
+ReplayWriter::~ReplayWriter() {
+	close();
+}
+
+bool ReplayWriter::open(const std::string& path, const Game& game, uint32_t keyframeInterval) {
+	close();
+
+	file.open(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) return false;
+
+	buffer.clear();
+	flushed = 0;
+	interval = keyframeInterval == 0 ? defaultInterval : keyframeInterval;
+	index.clear();
+	lastTick = game.ticks;
+	endTick = game.ticks;
+
+	putMagic(buffer, headerMagic);
+	buffer.put(replayVersion);
+	buffer.put(interval);
+	buffer.put(game.clock.step);
+	buffer.put(game.world.seed);
+
+	// seeks need something to start from, so the first thing in the file is the whole game
+	// the periodic keyframes before the start all point at it
+	uint64_t offset = flushed + buffer.size();
+	keyframe(game, true);
+	while ((uint64_t) index.size() * interval <= game.ticks) index.push_back(offset);
+	return true;
+}
+
+void ReplayWriter::close() {
+	if (!file.is_open()) return;
+
+	buffer.putVarint(((endTick - lastTick) << 3) | (uint64_t) ReplayRecord::End);
+
+	// index entries are fixed width so a reader can go straight to one
+	while ((flushed + buffer.size()) % 8 != 0) buffer.put((uint8_t) 0);
+	uint64_t indexOffset = flushed + buffer.size();
+	for (uint64_t offset : index) {
+		buffer.put(offset);
+	}
+
+	buffer.put(indexOffset);
+	buffer.put((uint64_t) index.size());
+	buffer.put(endTick);
+	putMagic(buffer, trailerMagic);
+	buffer.put(replayVersion);
+
+	flush(true);
+	file.close();
+}
+
+void ReplayWriter::flush(bool force) {
+	if (buffer.size() < flushSize && !force) return;
+
+	file.write((const char*) buffer.bytes.data(), (std::streamsize) buffer.size());
+	flushed += buffer.size();
+	buffer.clear();
+}
+
+void ReplayWriter::record(const Game& game, ReplayRecord kind) {
+	buffer.putVarint(((game.ticks - lastTick) << 3) | (uint64_t) kind);
+	lastTick = game.ticks;
+	endTick = std::max(endTick, game.ticks);
+}
+
+void ReplayWriter::putRotation(glm::vec2 rotation) {
+	for (int i = 0; i < 2; ++i) {
+		uint32_t bits = std::bit_cast<uint32_t>(rotation[i]) ^ std::bit_cast<uint32_t>(lastTurn[i]);
+		buffer.putVarint(reverseBytes(bits));
+	}
+	lastTurn = rotation;
+}
+
+void ReplayWriter::turn(const Game& game, size_t snake, glm::vec2 rotation) {
+	if (!isOpen()) return;
+
+	record(game, ReplayRecord::Turn);
+	buffer.putVarint(snake);
+	putRotation(rotation);
+	flush();
+}
+
+void ReplayWriter::setState(const Game& game, State state) {
+	if (!isOpen()) return;
+
+	record(game, ReplayRecord::SetState);
+	buffer.put((uint8_t) state);
+	flush();
+}
+
+void ReplayWriter::spawn(const Game& game, size_t snake, glm::vec3 head, glm::vec2 rotation, float length) {
+	if (!isOpen()) return;
+
+	record(game, ReplayRecord::Spawn);
+	buffer.putVarint(snake);
+	buffer.put(head);
+	buffer.put(rotation);
+	buffer.put(length);
+	flush();
+}
+
+void ReplayWriter::keyframe(const Game& game, bool reset) {
+	if (!isOpen()) return;
+
+	record(game, ReplayRecord::Keyframe);
+	buffer.put((uint8_t) reset);
+
+	ByteWriter snapshot;
+	writeGame(snapshot, game);
+	buffer.putVarint(snapshot.size());
+	buffer.putBytes(snapshot.bytes);
+
+	// readers can start at any keyframe, so nothing after one may depend on what came before it
+	lastTurn = glm::vec2(0.0f);
+	flush();
+}
+
+void ReplayWriter::capture(const Game& game) {
+	if (!isOpen()) return;
+
+	endTick = std::max(endTick, game.ticks);
+	if ((uint64_t) index.size() * interval > game.ticks) return;
+
+	uint64_t offset = flushed + buffer.size();
+	keyframe(game, false);
+	while ((uint64_t) index.size() * interval <= game.ticks) index.push_back(offset);
+}
+
+bool ReplayReader::open(const std::string& path) {
+	if (!file.open(path)) return false;
+
+	auto bytes = file.bytes();
+	ByteReader header(bytes);
+	if (!getMagic(header, headerMagic) || header.get<uint32_t>() != replayVersion) return false;
+
+	interval = header.get<uint32_t>();
+	step = header.getDouble();
+	seed = header.get<uint64_t>();
+	if (header.failed() || interval == 0) return false;
+
+	recordsBegin = headerSize;
+	recordsEnd = bytes.size();
+	endTick = UINT64_MAX;
+	index = {};
+
+	if (bytes.size() >= headerSize + trailerSize) {
+		ByteReader trailer(bytes.subspan(bytes.size() - trailerSize));
+		uint64_t indexOffset = trailer.get<uint64_t>();
+		uint64_t entries = trailer.get<uint64_t>();
+		uint64_t lastTick = trailer.get<uint64_t>();
+
+		bool complete = getMagic(trailer, trailerMagic) && trailer.get<uint32_t>() == replayVersion
+			&& indexOffset >= headerSize && indexOffset % 8 == 0 && entries > 0
+			&& indexOffset + entries * 8 == bytes.size() - trailerSize;
+		if (complete) {
+			index = bytes.subspan(indexOffset, entries * 8);
+			recordsEnd = indexOffset;
+			endTick = lastTick;
+		}
+	}
+
+	stream = ByteReader(bytes.first(recordsEnd));
+	pending = false;
+	return true;
+}
+
+bool ReplayReader::next() {
+	uint64_t head = stream.getVarint();
+	if (stream.failed()) {
+		pending = false;
+		return false;
+	}
+
+	pendingTick += head >> 3;
+	pendingKind = (ReplayRecord) (head & 7);
+	pending = true;
+	return true;
+}
+
+glm::vec2 ReplayReader::getRotation() {
+	glm::vec2 rotation;
+	for (int i = 0; i < 2; ++i) {
+		uint32_t bits = reverseBytes((uint32_t) stream.getVarint()) ^ std::bit_cast<uint32_t>(lastTurn[i]);
+		rotation[i] = std::bit_cast<float>(bits);
+	}
+	lastTurn = rotation;
+	return rotation;
+}
+
+bool ReplayReader::apply(Game& game, bool loadKeyframe) {
+	switch (pendingKind) {
+	case ReplayRecord::Turn: {
+		uint64_t snake = stream.getVarint();
+		glm::vec2 rotation = getRotation();
+		if (stream.failed() || snake >= game.snakes.size()) return false;
+
+		game.snakes[snake].setRotation(rotation);
+		break;
+	}
+	case ReplayRecord::SetState: {
+		uint8_t state = stream.get<uint8_t>();
+		if (stream.failed() || state > (uint8_t) State::Overing) return false;
+
+		game.state = (State) state;
+		break;
+	}
+	case ReplayRecord::Spawn: {
+		uint64_t snake = stream.getVarint();
+		glm::vec3 head = stream.getVec3();
+		glm::vec2 rotation = stream.getVec2();
+		float length = stream.getFloat();
+		if (stream.failed()) return false;
+
+		if (snake == game.snakes.size()) {
+			game.addSnake(Snake(head, rotation, length));
+		} else if (snake < game.snakes.size()) {
+			game.respawn(snake, Snake(head, rotation, length));
+		} else {
+			return false;
+		}
+		break;
+	}
+	case ReplayRecord::Keyframe: {
+		bool reset = stream.getBool();
+		uint64_t size = stream.getVarint();
+		auto snapshot = stream.getBytes(size);
+		if (stream.failed()) return false;
+
+		if (reset || loadKeyframe) {
+			ByteReader in(snapshot);
+			if (!readGame(in, game)) return false;
+			pendingTick = game.ticks;
+		}
+		lastTurn = glm::vec2(0.0f);
+		break;
+	}
+	case ReplayRecord::End:
+	default:
+		return false;
+	}
+
+	return !stream.failed();
+}
+
+bool ReplayReader::seek(Game& game, uint64_t tick) {
+	size_t offset = recordsBegin;
+
+	if (!index.empty()) {
+		uint64_t entries = index.size() / 8;
+		uint64_t k = std::min<uint64_t>(tick / interval, entries - 1);
+
+		auto entry = [&](uint64_t i) {
+			ByteReader in(index.subspan(i * 8, 8));
+			return (size_t) in.get<uint64_t>();
+		};
+
+		// the keyframe for an interval can be a frame's worth of ticks late, then the one before has to do
+		offset = entry(k);
+		ByteReader peek(file.bytes().first(recordsEnd));
+		peek.seek(offset);
+		peek.getVarint();
+		peek.getBool();
+		peek.getVarint();
+		auto at = peekGameTicks(peek);
+		if (!at) return false;
+		if (*at > tick && k > 0) offset = entry(k - 1);
+	}
+
+	stream.seek(offset);
+	if (!next() || pendingKind != ReplayRecord::Keyframe || !apply(game, true)) return false;
+	if (!next()) return false;
+
+	return play(game, tick) || game.ticks == tick;
+}
+
+bool ReplayReader::play(Game& game, uint64_t tick) {
+	while (game.ticks < tick) {
+		// everything recorded for this tick happens before it runs
+		while (pending && pendingTick == game.ticks && pendingKind != ReplayRecord::End) {
+			if (!apply(game, false) || !next()) return false;
+		}
+
+		if (!pending || (pendingKind == ReplayRecord::End && game.ticks >= pendingTick)) return false;
+		if (pendingTick < game.ticks) return false;
+
+		game.fixedTick();
+	}
+	return true;
+}
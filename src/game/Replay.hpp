@@ -0,0 +1,115 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include "Game.hpp"
+#include "ByteStream.hpp"
+#include "MappedFile.hpp"
+
+// a recorded session, everything that was done to a Game from outside tick for tick, so playing it back lands on
+// exactly the same states
+//
+// layout, all little endian:
+//   header   "WSRP", u32 version, u32 keyframe interval, f64 tick length, u64 seed of the first game
+//   records  varint (ticks since the previous record << 3 | kind), then the kind's payload
+//   index    u64 file offset of the keyframe for every multiple of the interval, first one at or after it
+//   trailer  u64 index offset, u64 index entries, u64 last tick, "WSRI", u32 version
+// records for a tick happen before that tick runs, i.e. while Game::ticks still has its number
+// a file without a trailer (the recorder died) still plays, seeking just has to start from the top
+
+enum class ReplayRecord : uint8_t {
+	Turn, // varint snake, rotation as two floats xor'd with the previous turn's, see putRotation
+	SetState, // u8 State, debug keys
+	Spawn, // varint snake, vec3 head, vec2 rotation, f32 length, Game::respawn with a straight snake
+	Keyframe, // u8 reset, varint size, Game snapshot, reset keyframes replace the state, the rest only mark it
+	End, // nothing, index follows
+};
+
+// 2: Waiting no longer ends by itself after a second, the SetState that ends it is recorded
+constexpr uint32_t replayVersion = 2;
+
+class ReplayWriter {
+private:
+	std::ofstream file;
+	ByteWriter buffer;
+	// bytes already in the file, buffer continues from here
+	uint64_t flushed = 0;
+	uint64_t lastTick = 0;
+	uint64_t endTick = 0;
+	uint32_t interval = 0;
+	glm::vec2 lastTurn = glm::vec2(0.0f);
+	std::vector<uint64_t> index;
+
+	void record(const Game& game, ReplayRecord kind);
+	void putRotation(glm::vec2 rotation);
+	void flush(bool force = false);
+
+public:
+	// 10 seconds at the default tick rate
+	static constexpr uint32_t defaultInterval = 600;
+
+	ReplayWriter() = default;
+	~ReplayWriter();
+
+	ReplayWriter(const ReplayWriter&) = delete;
+	ReplayWriter& operator=(const ReplayWriter&) = delete;
+
+	// starts a recording from game as it is now, false if the file can't be written
+	bool open(const std::string& path, const Game& game, uint32_t keyframeInterval = defaultInterval);
+	// writes the index and trailer, called by the destructor too
+	void close();
+
+	[[nodiscard]] bool isOpen() const { return file.is_open(); }
+
+	// every record is a no-op while nothing is open, so callers don't have to check
+	void turn(const Game& game, size_t snake, glm::vec2 rotation);
+	void setState(const Game& game, State state);
+	void spawn(const Game& game, size_t snake, glm::vec3 head, glm::vec2 rotation, float length);
+	// reset is for changes the other records can't express, e.g. a restart with a new world
+	void keyframe(const Game& game, bool reset);
+
+	// call after every batch of ticks, writes the periodic keyframes
+	void capture(const Game& game);
+};
+
+class ReplayReader {
+private:
+	MappedFile file;
+	ByteReader stream = ByteReader({});
+	std::span<const uint8_t> index;
+	size_t recordsBegin = 0;
+	size_t recordsEnd = 0;
+
+	// the next record's header, read ahead so play knows when to stop ticking
+	bool pending = false;
+	uint64_t pendingTick = 0;
+	ReplayRecord pendingKind = ReplayRecord::End;
+	glm::vec2 lastTurn = glm::vec2(0.0f);
+
+	bool next();
+	glm::vec2 getRotation();
+	bool apply(Game& game, bool loadKeyframe);
+
+public:
+	uint32_t interval = 0;
+	double step = 0.0;
+	uint64_t seed = 0;
+	// last tick of the recording, UINT64_MAX if it has no trailer
+	uint64_t endTick = 0;
+
+	// false if the file can't be mapped or isn't a replay
+	bool open(const std::string& path);
+
+	[[nodiscard]] bool hasIndex() const { return !index.empty(); }
+
+	// puts game in the state it had at tick, O(1) to find the keyframe then at most an interval of ticks
+	// ticks before the recording started land on its first state
+	bool seek(Game& game, uint64_t tick);
+
+	// runs game forward to tick applying the recording, false once the recording is over or broken
+	bool play(Game& game, uint64_t tick = UINT64_MAX);
+};
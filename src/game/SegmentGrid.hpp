@@ -0,0 +1,127 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <cstdint>
+#include <unordered_map>
+#include <glm/glm.hpp>
+
+// sparse hashed grid of body segments
+// segments are identified by a contiguous window of ids so both ends of the body can be added or dropped in O(cells touched)
+class SegmentGrid {
+public:
+	static constexpr float cellSize = 4.0f;
+
+private:
+	struct Box {
+		glm::ivec3 min;
+		glm::ivec3 max;
+	};
+
+	std::unordered_map<uint64_t, std::vector<int64_t>> cells;
+	// boxes[id - first] is the cell range the segment with that id was inserted into
+	std::deque<Box> boxes;
+	int64_t first;
+
+	static glm::ivec3 cellCoord(glm::vec3 pos) {
+		return glm::ivec3(glm::floor(pos / cellSize));
+	}
+
+	static uint64_t cellKey(int x, int y, int z) {
+		constexpr uint64_t mask = (1ull << 21) - 1;
+		return ((uint64_t) x & mask) | (((uint64_t) y & mask) << 21) | (((uint64_t) z & mask) << 42);
+	}
+
+	Box insert(int64_t id, glm::vec3 a, glm::vec3 b) {
+		Box box{ cellCoord(glm::min(a, b)), cellCoord(glm::max(a, b)) };
+
+		for (int z = box.min.z; z <= box.max.z; ++z) {
+			for (int y = box.min.y; y <= box.max.y; ++y) {
+				for (int x = box.min.x; x <= box.max.x; ++x) {
+					cells[cellKey(x, y, z)].push_back(id);
+				}
+			}
+		}
+		return box;
+	}
+
+	void erase(int64_t id, const Box& box) {
+		for (int z = box.min.z; z <= box.max.z; ++z) {
+			for (int y = box.min.y; y <= box.max.y; ++y) {
+				for (int x = box.min.x; x <= box.max.x; ++x) {
+					auto it = cells.find(cellKey(x, y, z));
+					if (it == cells.end()) continue;
+
+					auto& cell = it->second;
+					for (size_t i = 0; i < cell.size(); ++i) {
+						if (cell[i] == id) {
+							cell[i] = cell.back();
+							cell.pop_back();
+							break;
+						}
+					}
+					// don't let the map grow with every cell the snake ever passed through
+					if (cell.empty()) cells.erase(it);
+				}
+			}
+		}
+	}
+
+public:
+	SegmentGrid() : cells(), boxes(), first(0) {}
+
+	[[nodiscard]] bool empty() const { return boxes.empty(); }
+	[[nodiscard]] int64_t front() const { return first; }
+	[[nodiscard]] int64_t back() const { return first + (int64_t) boxes.size() - 1; }
+
+	// id must be front() - 1 unless the grid is empty
+	void pushFront(int64_t id, glm::vec3 a, glm::vec3 b) {
+		boxes.push_front(insert(id, a, b));
+		first = id;
+	}
+
+	// id must be back() + 1 unless the grid is empty
+	void pushBack(int64_t id, glm::vec3 a, glm::vec3 b) {
+		if (boxes.empty()) first = id;
+		boxes.push_back(insert(id, a, b));
+	}
+
+	void popFront() {
+		erase(first, boxes.front());
+		boxes.pop_front();
+		first++;
+	}
+
+	void popBack() {
+		erase(back(), boxes.back());
+		boxes.pop_back();
+	}
+
+	void clear() {
+		cells.clear();
+		boxes.clear();
+		first = 0;
+	}
+
+	// calls f(id) for every segment whose cells overlap the sphere's bounding box, ids may repeat
+	template <class F>
+	void query(glm::vec3 pos, float radius, F&& f) const {
+		if (boxes.empty()) return;
+
+		glm::ivec3 min = cellCoord(pos - radius);
+		glm::ivec3 max = cellCoord(pos + radius);
+
+		for (int z = min.z; z <= max.z; ++z) {
+			for (int y = min.y; y <= max.y; ++y) {
+				for (int x = min.x; x <= max.x; ++x) {
+					auto it = cells.find(cellKey(x, y, z));
+					if (it == cells.end()) continue;
+
+					for (int64_t id : it->second) {
+						f(id);
+					}
+				}
+			}
+		}
+	}
+};
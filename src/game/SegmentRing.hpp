@@ -0,0 +1,152 @@
+#pragma once
+
+#include <array>
+#include <span>
+#include <vector>
+#include <cstdint>
+#include <iterator>
+#include <initializer_list>
+#include <glm/glm.hpp>
+
+// power of two ring buffer of snake points, index 0 is the head
+// every point also has an id that never changes while it's alive (frontId() + index), ids are what the slots are keyed on,
+// so prepending a turn and dropping the tail are O(1) and nothing ever gets shifted
+class SegmentRing {
+private:
+	std::vector<glm::vec3> slots;
+	uint64_t mask;
+	int64_t first;
+	size_t count;
+
+	[[nodiscard]] size_t slot(int64_t id) const { return (size_t) ((uint64_t) id & mask); }
+
+	void grow() {
+		std::vector<glm::vec3> bigger(slots.empty() ? 16 : slots.size() * 2);
+		uint64_t biggerMask = bigger.size() - 1;
+		for (size_t i = 0; i < count; ++i) {
+			int64_t id = first + (int64_t) i;
+			bigger[(uint64_t) id & biggerMask] = slots[slot(id)];
+		}
+		slots = std::move(bigger);
+		mask = biggerMask;
+	}
+
+public:
+	template <bool Const>
+	class Iterator {
+	private:
+		using Ring = std::conditional_t<Const, const SegmentRing, SegmentRing>;
+		Ring* ring;
+		ptrdiff_t index;
+
+	public:
+		using iterator_category = std::random_access_iterator_tag;
+		using value_type = glm::vec3;
+		using difference_type = ptrdiff_t;
+		using pointer = std::conditional_t<Const, const glm::vec3*, glm::vec3*>;
+		using reference = std::conditional_t<Const, const glm::vec3&, glm::vec3&>;
+
+		Iterator() : ring(nullptr), index(0) {}
+		Iterator(Ring* ring, ptrdiff_t index) : ring(ring), index(index) {}
+
+		reference operator*() const { return (*ring)[index]; }
+		pointer operator->() const { return &(*ring)[index]; }
+		reference operator[](difference_type n) const { return (*ring)[index + n]; }
+
+		Iterator& operator++() { ++index; return *this; }
+		Iterator operator++(int) { Iterator old = *this; ++index; return old; }
+		Iterator& operator--() { --index; return *this; }
+		Iterator operator--(int) { Iterator old = *this; --index; return old; }
+		Iterator& operator+=(difference_type n) { index += n; return *this; }
+		Iterator& operator-=(difference_type n) { index -= n; return *this; }
+		Iterator operator+(difference_type n) const { return Iterator(ring, index + n); }
+		Iterator operator-(difference_type n) const { return Iterator(ring, index - n); }
+		friend Iterator operator+(difference_type n, const Iterator& it) { return it + n; }
+		difference_type operator-(const Iterator& other) const { return index - other.index; }
+
+		bool operator==(const Iterator& other) const { return index == other.index; }
+		auto operator<=>(const Iterator& other) const { return index <=> other.index; }
+	};
+
+	using iterator = Iterator<false>;
+	using const_iterator = Iterator<true>;
+
+	SegmentRing() : slots(), mask(0), first(0), count(0) {}
+
+	// empty, the first point pushed gets id frontId
+	explicit SegmentRing(int64_t frontId) : slots(), mask(0), first(frontId), count(0) {}
+
+	SegmentRing(std::initializer_list<glm::vec3> points) : SegmentRing() {
+		for (const auto& point : points) {
+			push_back(point);
+		}
+	}
+
+	[[nodiscard]] size_t size() const { return count; }
+	[[nodiscard]] bool empty() const { return count == 0; }
+	[[nodiscard]] size_t capacity() const { return slots.size(); }
+
+	// id of the head, decreases by one every push_front
+	[[nodiscard]] int64_t frontId() const { return first; }
+
+	glm::vec3& operator[](size_t i) { return slots[slot(first + (int64_t) i)]; }
+	const glm::vec3& operator[](size_t i) const { return slots[slot(first + (int64_t) i)]; }
+
+	// id must be in [frontId(), frontId() + size())
+	glm::vec3& at(int64_t id) { return slots[slot(id)]; }
+	const glm::vec3& at(int64_t id) const { return slots[slot(id)]; }
+
+	glm::vec3& front() { return (*this)[0]; }
+	const glm::vec3& front() const { return (*this)[0]; }
+	glm::vec3& back() { return (*this)[count - 1]; }
+	const glm::vec3& back() const { return (*this)[count - 1]; }
+
+	// by value, the point may live in the ring and growing moves it
+	void push_front(glm::vec3 point) {
+		if (count == slots.size()) grow();
+
+		first--;
+		slots[slot(first)] = point;
+		count++;
+	}
+
+	void push_back(glm::vec3 point) {
+		if (count == slots.size()) grow();
+
+		slots[slot(first + (int64_t) count)] = point;
+		count++;
+	}
+
+	void pop_front() {
+		first++;
+		count--;
+	}
+
+	void pop_back() {
+		count--;
+	}
+
+	// keeps the storage and the id sequence
+	void clear() {
+		first += (int64_t) count;
+		count = 0;
+	}
+
+	// the points in order as at most two contiguous runs, the second is empty unless the ring wraps
+	[[nodiscard]]
+	std::array<std::span<const glm::vec3>, 2> windows() const {
+		if (count == 0) return {};
+
+		size_t start = slot(first);
+		size_t firstRun = std::min(count, slots.size() - start);
+		return {
+			std::span<const glm::vec3>(slots.data() + start, firstRun),
+			std::span<const glm::vec3>(slots.data(), count - firstRun),
+		};
+	}
+
+	iterator begin() { return iterator(this, 0); }
+	iterator end() { return iterator(this, (ptrdiff_t) count); }
+	const_iterator begin() const { return const_iterator(this, 0); }
+	const_iterator end() const { return const_iterator(this, (ptrdiff_t) count); }
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+// fixed rate simulation clock, frames feed it real time and it hands back how many ticks to run
+class SimClock {
+public:
+	static constexpr double defaultRate = 60.0;
+	static constexpr int defaultMaxSubsteps = 5;
+
+	// seconds per tick
+	double step;
+	// most ticks a single frame may run, time past that is dropped so a hitch slows the game down instead of snowballing
+	int maxSubsteps;
+	// real time not yet simulated, always below step after advance
+	double accumulator;
+
+	SimClock(double rate = defaultRate, int maxSubsteps = defaultMaxSubsteps) :
+		step(1.0 / rate),
+		maxSubsteps(maxSubsteps),
+		accumulator(0.0) {}
+
+	// returns the number of ticks frameDt covers
+	int advance(double frameDt) {
+		accumulator += frameDt;
+
+		int steps = (int) (accumulator / step);
+		if (steps > maxSubsteps) {
+			steps = maxSubsteps;
+			accumulator = 0.0;
+		} else {
+			accumulator -= steps * step;
+		}
+
+		return steps;
+	}
+
+	// how far the frame is between the last tick and the next one, 0 - 1
+	[[nodiscard]]
+	float alpha() const {
+		return (float) (accumulator / step);
+	}
+
+	void reset() {
+		accumulator = 0.0;
+	}
+};
@@ -1,44 +1,208 @@
 #pragma once
 
+#include <span>
 #include <vector>
 #include <numbers>
+#include <optional>
+#include <algorithm>
 #include <glm/glm.hpp>
 
 #include "../MathUtils.hpp"
 
 #include "Object.hpp"
 #include "World.hpp"
+#include "SegmentGrid.hpp"
+#include "SegmentRing.hpp"
+#include "Swept.hpp"
 
 enum class LoseCode : unsigned char {
 	None, // didn't lose
 	Shrunk,	//shrunk out of existence
 	Walled, //hit wall
 	Snaked, //hit self
+	Bitten, //hit another snake
 };
 
+// what one snake's tick found, the world is only changed once every snake has moved
+struct TickResult {
+	LoseCode lose = LoseCode::None;
+	// fraction of the tick at which the head hit what it lost to, 1 if it didn't lose
+	float impact = 1.0f;
+	struct Reached {
+		// fraction of the tick
+		float t;
+		// into World::objects
+		uint32_t index;
+
+		auto operator<=>(const Reached&) const = default;
+	};
+
+	// foods the head ran through, in the order it reached them
+	std::vector<Reached> foods;
+
+	// keeps the storage, results get reused every tick
+	void clear() {
+		lose = LoseCode::None;
+		impact = 1.0f;
+		foods.clear();
+	}
+};
+
+class ByteWriter;
+class ByteReader;
+
 class Snake {
 private:
+	friend void writeSnake(ByteWriter& out, const Snake& snake);
+	friend bool readSnake(ByteReader& in, Snake& snake);
+
 	// flag preventing multiple turn segments being created per frame.
 	bool turned = false;
 	double timeSinceTurn = 100000.0;
 	glm::vec2 queuedRotation = glm::vec2(-100.0f);
 
+	// head and tail as of the start of the last tick, for drawing in between ticks
+	// prevHead is also where the head's motion over the last tick started
+	glm::vec3 prevHead = glm::vec3(0.0f);
+	glm::vec3 prevTail = glm::vec3(0.0f);
+	// if the tail point got popped since, prevTail was on a segment that no longer exists
+	int64_t prevTailId = 0;
+
+	// segment i (segments[i - 1] to segments[i]) is keyed by the ring id of segments[i]
+	// only segments with both ends fixed live here, the head and tail segments move every tick and are tested directly
+	SegmentGrid body;
+
+	// brings body in line with segments, only touches the ends that changed
+	void syncBody() {
+		if (segments.size() < 4) {
+			body.clear();
+			return;
+		}
+
+		int64_t wantFirst = segments.frontId() + 2;
+		int64_t wantLast = segments.frontId() + (int64_t) segments.size() - 2;
+
+		while (!body.empty() && body.back() > wantLast) body.popBack();
+		while (!body.empty() && body.front() < wantFirst) body.popFront();
+
+		// the tail end never grows, if it has to something replaced the segments wholesale
+		if (!body.empty() && body.back() < wantLast) body.clear();
+
+		if (body.empty()) {
+			for (int64_t id = wantFirst; id <= wantLast; ++id) {
+				body.pushBack(id, segments.at(id - 1), segments.at(id));
+			}
+		}
+
+		while (body.front() > wantFirst) {
+			int64_t id = body.front() - 1;
+			body.pushFront(id, segments.at(id - 1), segments.at(id));
+		}
+	}
+
 protected:
 	glm::vec2 rotation;
 	float length;
 
 public:
-	std::vector<glm::vec3> segments;
+	// head first, turns push to the front and the tail pops off the back
+	SegmentRing segments;
 	size_t foodsEaten = 0;
 
 	static constexpr float radius = 0.5f;
 	static constexpr float speed = 2.0f; // speed in m/s
 	float shrinkage = glm::pow(0.5f, 1.0f / 30.0f);
 
-	Snake() :
-		segments({ glm::vec3(0.0), glm::vec3(0.0, 0.0, -20.0) }),
-		rotation(),
-		length(20.0f) {}
+	// distance from obj to the capsule s1 - s2, the narrowphase for anything tested against a snake
+	// https://iquilezles.org/articles/distfunctions/
+	[[nodiscard]]
+	static float segmentDist(Object obj, glm::vec3 s1, glm::vec3 s2) {
+		glm::vec3 pa = obj.pos - s1, ba = s2 - s1;
+
+		// a turn leaves a zero length segment at the head for a tick, that's just a point
+		float baba = glm::dot(ba, ba);
+		float h = baba > 0.0f ? glm::dot(pa, ba) / baba : 0.0f;
+
+		// clamp 0.0 - 1.0
+		if (h < 0.0) h = 0.0;
+		if (h > 1.0) h = 1.0;
+
+		return glm::length(pa - ba * h) - obj.radius;
+	}
+
+	// segments with the head and tail put back alpha of the way through the last tick
+	struct Interpolated {
+		const SegmentRing& points;
+		glm::vec3 head;
+		glm::vec3 tail;
+
+		[[nodiscard]] size_t size() const { return points.size(); }
+
+		glm::vec3 operator[](size_t i) const {
+			if (i == 0) return head;
+			if (i == points.size() - 1) return tail;
+			return points[i];
+		}
+	};
+
+	Snake() : Snake(glm::vec3(0.0f), glm::vec2(0.0f)) {}
+
+	// straight snake with its head at head, facing rotation
+	Snake(glm::vec3 head, glm::vec2 rotation, float length = 20.0f) :
+		rotation(rotation),
+		length(length),
+		segments({ head, head - direction(rotation) * length }) {
+		savePrevious();
+	}
+
+	// snake along points, head first, as long as the path they trace, for shapes turning would take ages to make
+	Snake(std::span<const glm::vec3> points, glm::vec2 rotation) : rotation(rotation), length(0.0f) {
+		for (size_t i = 0; i < points.size(); ++i) {
+			segments.push_back(points[i]);
+			if (i > 0) length += glm::distance(points[i - 1], points[i]);
+		}
+		syncBody();
+		savePrevious();
+	}
+
+	[[nodiscard]]
+	static glm::vec3 direction(glm::vec2 rotation) {
+		glm::vec2 sin = glm::sin(glm::radians(rotation));
+		glm::vec2 cos = glm::cos(glm::radians(rotation));
+		return glm::vec3(-sin.x * cos.y, sin.y, cos.x * cos.y);
+	}
+
+	[[nodiscard]]
+	float getLength() const {
+		return length;
+	}
+
+	// where the head was before the last move, the head swept the segment from here to segments[0]
+	[[nodiscard]]
+	glm::vec3 moveStart() const {
+		return prevHead;
+	}
+
+	// call before every tick
+	void savePrevious() {
+		if (segments.empty()) return;
+
+		prevHead = segments.front();
+		prevTail = segments.back();
+		prevTailId = segments.frontId() + (int64_t) segments.size() - 1;
+	}
+
+	[[nodiscard]]
+	Interpolated interpolated(float alpha) const {
+		if (segments.size() < 2) return { segments, glm::vec3(0.0f), glm::vec3(0.0f) };
+
+		glm::vec3 head = glm::mix(prevHead, segments.front(), alpha);
+		glm::vec3 tail = segments.back();
+		if (segments.frontId() + (int64_t) segments.size() - 1 == prevTailId) {
+			tail = glm::mix(prevTail, tail, alpha);
+		}
+		return { segments, head, tail };
+	}
 
 	void setRotation(glm::vec2 rotation) {
 		rotation.x = normalizeAngle(rotation.x);
@@ -51,7 +215,10 @@ public:
 				queuedRotation = rotation;
 			} else {
 				if (!turned) {
-					segments.insert(segments.begin(), segments[0]);
+					segments.push_front(segments[0]);
+					syncBody();
+					// the old head is a fixed corner now, drawing the new one behind it would fold the body back
+					prevHead = segments.front();
 					timeSinceTurn = 0.0;
 					turned = true;
 				}
@@ -61,36 +228,66 @@ public:
 		}
 	}
 
+	// distance from obj to the closest segment, skipping the first offset segments behind the head
+	// only segments near obj are visited, so anything that doesn't touch obj may report a larger distance than the true one
 	[[nodiscard]]
-	constexpr float dist(Object obj, int offset = 0) const {
+	float dist(Object obj, int offset = 0) const {
 
 		// really big number
 		float current = std::numeric_limits<float>::max();
 
-		// https://iquilezles.org/articles/distfunctions/
-		auto dist = [&](glm::vec3 s1, glm::vec3 s2) {
-			glm::vec3 pa = obj.pos - s1, ba = s2 - s1;
+		// a single segment snake should not exist
+		if (segments.size() < 2) return current;
+
+		size_t first = 1 + offset;
+		size_t tail = segments.size() - 1;
 
-			float h = glm::dot(pa, ba) / glm::dot(ba, ba);
+		// head and tail segments, with fewer than 4 points these are all of them
+		if (first <= 1) current = glm::min(current, segmentDist(obj, segments[0], segments[1]));
+		if (tail > 1 && tail >= first) current = glm::min(current, segmentDist(obj, segments[tail - 1], segments[tail]));
 
-			// clamp 0.0 - 1.0
-			if (h < 0.0) h = 0.0;
-			if (h > 1.0) h = 1.0;
+		body.query(obj.pos, obj.radius, [&](int64_t id) {
+			size_t i = (size_t) (id - segments.frontId());
+			if (i >= first) current = glm::min(current, segmentDist(obj, segments[i - 1], segments[i]));
+		});
+
+		return current;
+	}
+
+	// earliest fraction of motion at which obj moving by motion touches a segment, skipping the first offset segments
+	// behind the head like dist, nullopt if it never does
+	[[nodiscard]]
+	std::optional<float> impact(Object obj, glm::vec3 motion, int offset = 0) const {
+		if (segments.size() < 2) return std::nullopt;
 
-			return glm::length(pa - ba * h) - obj.radius;
+		size_t first = 1 + offset;
+		size_t tail = segments.size() - 1;
+
+		std::optional<float> earliest;
+		auto consider = [&](size_t i) {
+			auto t = sweepCapsule(obj.pos, motion, segments[i - 1], segments[i], obj.radius);
+			if (t && (!earliest || *t < *earliest)) earliest = t;
 		};
 
-		// a single segment snake should not exist
-		for (int i = 1 + offset; i < segments.size(); ++i) {
-			current = glm::min(current, dist(segments[i - 1], segments[i]));
-		}
+		if (first <= 1) consider(1);
+		if (tail > 1 && tail >= first) consider(tail);
 
-		return current;
+		// every segment the move can reach has a cell inside the sphere around the path
+		body.query(obj.pos + motion * 0.5f, glm::length(motion) * 0.5f + obj.radius, [&](int64_t id) {
+			size_t i = (size_t) (id - segments.frontId());
+			if (i >= first) consider(i);
+		});
+
+		return earliest;
 	}
 
 	// this isn't accurate to the model at all!
 	[[nodiscard]]
-	constexpr bool collides(Object obj) const {
+	bool collides(Object obj) const {
+		if (segments.size() < 2) return false;
+
+		// no part of the body is further from the head than the body is long, the extra meter covers float drift in length
+		if (glm::distance(obj.pos, segments.front()) > length + radius + obj.radius + 1.0f) return false;
 
 		// ignore the lack of short curcuit eval
 		return dist(obj) <= 0.0;
@@ -118,10 +315,12 @@ public:
 		}
 
 		if (len > 0.0f) [[unlikely]] {
-			segments = {};
+			segments.clear();
 			length = 0.0f;
 		}
-		
+
+		syncBody();
+
 	}
 
 	// shinks snake based on delta time
@@ -131,8 +330,9 @@ public:
 		float newLength = length * glm::pow(shrinkage, dt);
 
 		if (newLength <= radius) {
-			segments = {}; //you just died!
+			segments.clear(); //you just died!
 			length = 0.0f;
+			syncBody();
 		}
 		else {
 			float dLength = length - newLength;
@@ -154,9 +354,12 @@ public:
 		back += ndir; // ignore that this can be abused to have the tail go out of bounds
 	}
 
-	// returns a LoseCode other than None on game end
-	[[nodiscard]] 
-	LoseCode tick(float dt, World& world) {
+	// first half of a tick, moves the snake and looks for what it hit without changing the world
+	// snakes only touch their own state here, so any number of them can move at once against the same world
+	// the head is swept along its whole move, so a coarse dt can't carry it through anything
+	void move(float dt, const World& world, TickResult& result) {
+		result.clear();
+
 		if (queuedRotation != glm::vec2(-100.0) && timeSinceTurn * speed > radius) {
 			setRotation(queuedRotation);
 			queuedRotation = glm::vec2(-100.0);
@@ -164,53 +367,58 @@ public:
 		timeSinceTurn += dt;
 
 		turned = false;
+		savePrevious();
 		auto& head = segments[0];
 
-		glm::vec2 sin = glm::sin(glm::radians(this->rotation));
-		glm::vec2 cos = glm::cos(glm::radians(this->rotation));
-		glm::vec3 dir = glm::vec3(-sin.x * cos.y, sin.y, cos.x * cos.y);
-		glm::vec3 target = head + speed * dir * dt;
-		Object bounding{ target, radius };
-
-		if (glm::abs(target.x) > 64.0f ||
-			glm::abs(target.y) > 64.0f ||
-			glm::abs(target.z) > 64.0f) {
+		glm::vec3 motion = speed * direction(this->rotation) * dt;
+		glm::vec3 target = head + motion;
+		Object bounding{ head, radius };
 
+		if (auto t = sweepWalls(head, motion, (float) world.half)) {
 			// snake out of bounds :(
-			return LoseCode::Walled;
+			result.lose = LoseCode::Walled;
+			result.impact = *t;
 		}
 
-		if (dist(bounding, 2) <= 0.0) {
+		if (auto t = impact(bounding, motion, 2); t && *t < result.impact) {
 			// snake collided with self :(
-			return LoseCode::Snaked;
+			result.lose = LoseCode::Snaked;
+			result.impact = *t;
 		}
 
-		//@TODO deal with large, rapid, and evil dt changes
+		if (result.lose != LoseCode::None) return;
 
-		auto collided = world.checkCollision(bounding);
-
-		if (collided != nullptr) {
-			switch (collided->item)
-			{
-			case Item::Food:
-				grow();
-				world.moveObj(*collided, *this);
-				foodsEaten += 1;
-				break;
-			default:
-				break;
-			}
-		}
+		world.sweepCollisions(bounding, motion, [&](uint32_t index, float t) {
+			if (world.objects[index].item == Item::Food) result.foods.push_back({ t, index });
+		});
+		// index breaks ties so the order never depends on how the grid was walked
+		std::sort(result.foods.begin(), result.foods.end());
 
 		shrink(dt);
 
 		if (segments.size() < 2) {
 			// shrunk or something :(
-			return LoseCode::Shrunk;
+			result.lose = LoseCode::Shrunk;
+			result.foods.clear();
+			return;
 		}
 
 		head = target;
 		shrinkLen(speed * dt);
-		return LoseCode::None;
-	};
+	}
+
+	// second half of a tick, eats what move found if nobody got to it first
+	// collider is whatever respawned food has to stay clear of, see World::moveObj
+	template <class T>
+	bool eat(World& world, uint32_t food, const T& collider) {
+		auto& object = world.objects[food];
+
+		// a snake before this one ate it and it's somewhere else now, or not reached at all this tick
+		if (object.item != Item::Food || segmentDist(Object{ object.pos, object.radius + radius }, prevHead, segments[0]) > 0.0f) return false;
+
+		grow();
+		world.moveObj(object, collider);
+		foodsEaten += 1;
+		return true;
+	}
 };
\ No newline at end of file
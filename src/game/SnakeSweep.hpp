@@ -0,0 +1,209 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+#include "Snake.hpp"
+#include "Swept.hpp"
+
+// sweep and prune over x for snake vs snake collisions
+// every segment of every snake gets a box, so does every head, and the boxes stay sorted by their low x between ticks
+// snakes only move a few centimetres a tick, so re-sorting the old order is an insertion sort with almost nothing to do
+class SnakeSweep {
+private:
+	struct Entry {
+		glm::vec3 min;
+		glm::vec3 max;
+		uint32_t snake;
+		// ring id of the segment's second point, see Snake::segments, head is the head box
+		int64_t id;
+
+		static constexpr int64_t head = INT64_MIN;
+	};
+
+	// snake ids this sweep has boxes for, empty when first > last
+	struct Tracked {
+		int64_t first;
+		int64_t last;
+		bool head;
+	};
+
+	// an entry whose x range is still open during the sweep, with the bounds the overlap test needs copied in
+	// so walking the list doesn't jump around entries
+	struct Active {
+		float maxX;
+		glm::vec2 minYZ;
+		glm::vec2 maxYZ;
+		uint32_t index;
+	};
+
+	std::vector<Entry> entries;
+	std::vector<Tracked> tracked;
+	// scratch for the sweep
+	std::vector<Active> activeHeads;
+	std::vector<Active> activeBodies;
+
+	static void boxSegment(Entry& entry, const Snake& snake) {
+		glm::vec3 a = snake.segments.at(entry.id - 1);
+		glm::vec3 b = snake.segments.at(entry.id);
+		entry.min = glm::min(a, b);
+		entry.max = glm::max(a, b);
+	}
+
+	// covers the whole path the head took over the last move
+	// padded a hair past the radius, snakes run along lattice lines and often touch at exactly the radius, where
+	// rounding in the box could drop a pair the capsule test keeps
+	static void boxHead(Entry& entry, const Snake& snake) {
+		constexpr float reach = Snake::radius + 1e-3f;
+		entry.min = glm::min(snake.moveStart(), snake.segments.front()) - reach;
+		entry.max = glm::max(snake.moveStart(), snake.segments.front()) + reach;
+	}
+
+	[[nodiscard]]
+	static Active activate(const Entry& entry, uint32_t index) {
+		return { entry.max.x, glm::vec2(entry.min.y, entry.min.z), glm::vec2(entry.max.y, entry.max.z), index };
+	}
+
+	[[nodiscard]]
+	static bool overlapsYZ(const Active& a, const Active& b) {
+		return a.minYZ.x <= b.maxYZ.x && b.minYZ.x <= a.maxYZ.x && a.minYZ.y <= b.maxYZ.y && b.minYZ.y <= a.maxYZ.y;
+	}
+
+	// narrowphase, the head swept along its last move against the other snake where it is now
+	// same capsule test Snake::impact uses against its own body
+	[[nodiscard]]
+	static bool bites(const Entry& head, const Entry& body, const std::vector<Snake>& snakes) {
+		if (head.snake == body.snake) return false;
+
+		const auto& biter = snakes[head.snake];
+		const auto& snake = snakes[body.snake];
+		glm::vec3 motion = biter.segments.front() - biter.moveStart();
+		return sweepCapsule(biter.moveStart(), motion, snake.segments.at(body.id - 1), snake.segments.at(body.id), Snake::radius).has_value();
+	}
+
+public:
+	// brings the boxes in line with the snakes and re-sorts them, snakes where alive(i) is false are left out
+	// snakes can be replaced or added freely in between, boxes are only kept for ids the snake still has
+	template <class Alive>
+	void update(const std::vector<Snake>& snakes, Alive&& alive) {
+		tracked.assign(snakes.size(), Tracked{ INT64_MAX, INT64_MIN, false });
+
+		// refresh what's still there, head and tail segments moved and the tail may have lost points
+		size_t kept = 0;
+		for (size_t i = 0; i < entries.size(); ++i) {
+			Entry entry = entries[i];
+			if (entry.snake >= snakes.size() || !alive(entry.snake)) continue;
+
+			const auto& snake = snakes[entry.snake];
+			auto& range = tracked[entry.snake];
+			if (snake.segments.size() < 2) continue;
+
+			if (entry.id == Entry::head) {
+				boxHead(entry, snake);
+				range.head = true;
+			} else {
+				int64_t first = snake.segments.frontId() + 1;
+				int64_t last = snake.segments.frontId() + (int64_t) snake.segments.size() - 1;
+				if (entry.id < first || entry.id > last) continue;
+
+				boxSegment(entry, snake);
+				range.first = std::min(range.first, entry.id);
+				range.last = std::max(range.last, entry.id);
+			}
+			entries[kept++] = entry;
+		}
+		entries.resize(kept);
+
+		// insertion sort, the survivors barely moved so almost everything is already in place
+		for (size_t i = 1; i < entries.size(); ++i) {
+			if (entries[i - 1].min.x <= entries[i].min.x) continue;
+
+			Entry entry = entries[i];
+			size_t j = i;
+			while (j > 0 && entries[j - 1].min.x > entry.min.x) {
+				entries[j] = entries[j - 1];
+				j--;
+			}
+			entries[j] = entry;
+		}
+
+		// whatever the snakes have that isn't boxed yet, mostly the segment a turn just pushed on the front
+		for (uint32_t s = 0; s < snakes.size(); ++s) {
+			const auto& snake = snakes[s];
+			if (!alive(s) || snake.segments.size() < 2) continue;
+
+			const auto& range = tracked[s];
+			if (!range.head) {
+				Entry entry{ glm::vec3(0.0f), glm::vec3(0.0f), s, Entry::head };
+				boxHead(entry, snake);
+				entries.push_back(entry);
+			}
+
+			int64_t first = snake.segments.frontId() + 1;
+			int64_t last = snake.segments.frontId() + (int64_t) snake.segments.size() - 1;
+			for (int64_t id = first; id <= last; ++id) {
+				if (id >= range.first && id <= range.last) {
+					id = range.last;
+					continue;
+				}
+
+				Entry entry{ glm::vec3(0.0f), glm::vec3(0.0f), s, id };
+				boxSegment(entry, snake);
+				entries.push_back(entry);
+			}
+		}
+
+		// new boxes can belong anywhere, sorting them on their own and merging is linear where inserting each one wouldn't be
+		auto byX = [](const Entry& a, const Entry& b) { return a.min.x < b.min.x; };
+		std::sort(entries.begin() + kept, entries.end(), byX);
+		std::inplace_merge(entries.begin(), entries.begin() + kept, entries.end(), byX);
+	}
+
+	// sets out[i] for every snake whose head touches another snake, as of the last update
+	// heads are only tested against bodies, bodies against each other would be most of the pairs and never matter
+	void bitten(const std::vector<Snake>& snakes, std::vector<uint8_t>& out) {
+		out.assign(snakes.size(), 0);
+		activeHeads.clear();
+		activeBodies.clear();
+
+		// drops whatever closed before x and hands the rest to f, one pass for both
+		auto walk = [](std::vector<Active>& active, float x, auto&& f) {
+			size_t kept = 0;
+			for (size_t k = 0; k < active.size(); ++k) {
+				Active open = active[k];
+				if (open.maxX < x) continue;
+
+				active[kept++] = open;
+				f(open);
+			}
+			active.resize(kept);
+		};
+
+		for (uint32_t i = 0; i < entries.size(); ++i) {
+			const auto& entry = entries[i];
+			Active current = activate(entry, i);
+
+			// a list is only pruned when it's walked, bodies pile up between heads otherwise for nothing
+			if (entry.id == Entry::head) {
+				walk(activeBodies, entry.min.x, [&](const Active& body) {
+					if (overlapsYZ(current, body) && bites(entry, entries[body.index], snakes)) out[entry.snake] = 1;
+				});
+				activeHeads.push_back(current);
+			} else {
+				walk(activeHeads, entry.min.x, [&](const Active& head) {
+					if (overlapsYZ(head, current) && bites(entries[head.index], entry, snakes)) out[entries[head.index].snake] = 1;
+				});
+				activeBodies.push_back(current);
+			}
+		}
+	}
+
+	[[nodiscard]] size_t size() const { return entries.size(); }
+
+	void clear() {
+		entries.clear();
+		tracked.clear();
+	}
+};
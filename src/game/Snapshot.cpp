@@ -0,0 +1,575 @@
+#include "Snapshot.hpp"
+
+#include <cmath>
+#include <fstream>
+#include <cstddef>
+#include <algorithm>
+
+#include "Game.hpp"
+#include "MappedFile.hpp"
+
+static constexpr char imageMagic[4] = { 'W', 'S', 'I', 'M' };
+
+// count records of at least size bytes each fit in what's left, counts come from the file so count * size could wrap
+static bool fits(const ByteReader& in, uint64_t count, size_t size) {
+	return !in.failed() && count <= in.remaining() / size;
+}
+
+void writeSnake(ByteWriter& out, const Snake& snake) {
+	out.put(snake.turned);
+	out.put(snake.timeSinceTurn);
+	out.put(snake.queuedRotation);
+	out.put(snake.prevHead);
+	out.put(snake.prevTail);
+	out.put(snake.prevTailId);
+	out.put(snake.rotation);
+	out.put(snake.length);
+	out.put((uint64_t) snake.foodsEaten);
+	out.put(snake.shrinkage);
+
+	out.put(snake.segments.frontId());
+	out.putVarint(snake.segments.size());
+	for (const auto& point : snake.segments) {
+		out.put(point);
+	}
+}
+
+bool readSnake(ByteReader& in, Snake& snake) {
+	snake.turned = in.getBool();
+	snake.timeSinceTurn = in.getDouble();
+	snake.queuedRotation = in.getVec2();
+	snake.prevHead = in.getVec3();
+	snake.prevTail = in.getVec3();
+	snake.prevTailId = in.get<int64_t>();
+	snake.rotation = in.getVec2();
+	snake.length = in.getFloat();
+	snake.foodsEaten = (size_t) in.get<uint64_t>();
+	snake.shrinkage = in.getFloat();
+
+	int64_t frontId = in.get<int64_t>();
+	uint64_t count = in.getVarint();
+	// 12 bytes a point, anything claiming more than is left is garbage
+	if (!fits(in, count, 12)) return false;
+
+	snake.segments = SegmentRing(frontId);
+	for (uint64_t i = 0; i < count; ++i) {
+		snake.segments.push_back(in.getVec3());
+	}
+	snake.syncBody();
+	return !in.failed();
+}
+
+static void putCoord(ByteWriter& out, glm::ivec3 coord) {
+	out.putSigned(coord.x);
+	out.putSigned(coord.y);
+	out.putSigned(coord.z);
+}
+
+static glm::ivec3 getCoord(ByteReader& in) {
+	int x = (int) in.getSigned();
+	int y = (int) in.getSigned();
+	return glm::ivec3(x, y, (int) in.getSigned());
+}
+
+static void putFood(ByteWriter& out, const ItemObj& object) {
+	out.put(object.pos);
+	out.put(object.radius);
+	out.put((uint8_t) object.item);
+}
+
+static ItemObj getFood(ByteReader& in) {
+	ItemObj object{};
+	object.pos = in.getVec3();
+	object.radius = in.getFloat();
+	object.item = (Item) in.get<uint8_t>();
+	return object;
+}
+
+// anything past Item::None came from a corrupt or foreign file
+static bool knownItems(const std::vector<ItemObj>& objects) {
+	return std::all_of(objects.begin(), objects.end(), [](const ItemObj& object) { return object.item <= Item::None; });
+}
+
+// slots and grid indices all point into objects
+static bool allBelow(const std::vector<uint32_t>& values, uint64_t count) {
+	return std::all_of(values.begin(), values.end(), [count](uint32_t value) { return value < count; });
+}
+
+// keys of the stored chunks in order, so the bytes don't depend on how the hash map is laid out
+static std::vector<uint64_t> storedKeys(const World& world) {
+	std::vector<uint64_t> keys;
+	for (const auto& [key, foods] : world.stored) keys.push_back(key);
+	std::sort(keys.begin(), keys.end());
+	return keys;
+}
+
+static void writeWorldHead(ByteWriter& out, const World& world) {
+	out.put(world.seed);
+	out.put(world.rng.position());
+	out.put((int32_t) world.half);
+	out.put(world.foodTotal);
+	out.put(world.streamRadius);
+	out.put(world.margin);
+}
+
+// clears world and sets what writeWorldHead wrote, false if the arena size isn't one World could have
+static bool readWorldHead(ByteReader& in, World& world) {
+	uint64_t seed = in.get<uint64_t>();
+	uint64_t position = in.get<uint64_t>();
+	int half = in.get<int32_t>();
+	uint64_t foodTotal = in.get<uint64_t>();
+	float streamRadius = in.getFloat();
+	float margin = in.getFloat();
+	if (in.failed() || half < Chunk::size || half > World::maxHalf || half % Chunk::size != 0) return false;
+
+	world.resize(half);
+	world.reseed(seed);
+	world.rng.seek(position);
+	world.foodTotal = foodTotal;
+	world.streamRadius = streamRadius;
+	world.margin = margin;
+	return true;
+}
+
+// registers a chunk read from a snapshot, false if it's outside the arena or already there
+static Chunk* addChunk(World& world, glm::ivec3 coord, bool dirty) {
+	uint64_t key = Chunk::key(coord);
+	if (!world.inArena(coord) || world.chunkIndex.contains(key)) return nullptr;
+
+	Chunk& chunk = world.addChunk(coord);
+	chunk.dirty = dirty;
+	return &chunk;
+}
+
+void writeWorld(ByteWriter& out, const World& world) {
+	writeWorldHead(out, world);
+
+	out.putVarint(world.objects.size());
+	for (const auto& object : world.objects) {
+		putFood(out, object);
+	}
+
+	out.putVarint(world.freeSlots.size());
+	for (uint32_t slot : world.freeSlots) {
+		out.putVarint(slot);
+	}
+
+	out.putVarint(world.chunks.size());
+	for (const auto& chunk : world.chunks) {
+		putCoord(out, chunk->coord);
+		out.put(chunk->dirty);
+		out.putVarint(chunk->slots.size());
+		for (uint32_t slot : chunk->slots) {
+			out.putVarint(slot);
+		}
+	}
+
+	auto keys = storedKeys(world);
+	out.putVarint(keys.size());
+	for (uint64_t key : keys) {
+		const auto& foods = world.stored.at(key);
+		putCoord(out, Chunk::unkey(key));
+		out.putVarint(foods.size());
+		for (const auto& food : foods) {
+			putFood(out, food);
+		}
+	}
+
+	out.putVarint(world.streamedFrom.size());
+	for (const auto& at : world.streamedFrom) {
+		out.put(at.has_value());
+		if (at) putCoord(out, *at);
+	}
+}
+
+bool readWorld(ByteReader& in, World& world) {
+	if (!readWorldHead(in, world)) return false;
+
+	uint64_t count = in.getVarint();
+	if (count > UINT32_MAX || !fits(in, count, 17)) return false;
+
+	world.objects.reserve(count);
+	for (uint64_t i = 0; i < count; ++i) {
+		world.objects.push_back(getFood(in));
+		world.foods.push(world.objects.back());
+	}
+	if (!knownItems(world.objects)) return false;
+
+	auto getSlot = [&] {
+		uint64_t slot = in.getVarint();
+		if (slot >= count) in.seek(SIZE_MAX);
+		return (uint32_t) slot;
+	};
+
+	uint64_t freeCount = in.getVarint();
+	if (in.failed() || !in.has(freeCount)) return false;
+	for (uint64_t i = 0; i < freeCount; ++i) {
+		world.freeSlots.push_back(getSlot());
+	}
+
+	uint64_t chunkCount = in.getVarint();
+	if (!fits(in, chunkCount, 5)) return false;
+	for (uint64_t i = 0; i < chunkCount; ++i) {
+		glm::ivec3 coord = getCoord(in);
+		bool dirty = in.getBool();
+		uint64_t slots = in.getVarint();
+		Chunk* chunk = addChunk(world, coord, dirty);
+		if (in.failed() || chunk == nullptr || !in.has(slots)) return false;
+
+		// the grid and occupancy map only ever hold what the slots say, so they're rebuilt from them
+		std::vector<size_t> cells;
+		for (uint64_t k = 0; k < slots; ++k) {
+			uint32_t slot = getSlot();
+			if (in.failed()) return false;
+
+			chunk->slots.push_back(slot);
+			const auto& object = world.objects[slot];
+			if (object.item == Item::None) continue;
+
+			chunk->grid.insert(object.pos, object.radius, slot);
+			cells.push_back(chunk->cellOf(object.pos));
+		}
+		chunk->occupancy.occupyAll(cells, 1);
+	}
+
+	uint64_t storedCount = in.getVarint();
+	if (!fits(in, storedCount, 4)) return false;
+	for (uint64_t i = 0; i < storedCount; ++i) {
+		uint64_t key = Chunk::key(getCoord(in));
+		uint64_t foods = in.getVarint();
+		if (!fits(in, foods, 17)) return false;
+
+		auto& keep = world.stored[key];
+		for (uint64_t k = 0; k < foods; ++k) {
+			keep.push_back(getFood(in));
+		}
+		if (!knownItems(keep)) return false;
+	}
+
+	uint64_t heads = in.getVarint();
+	if (in.failed() || !in.has(heads)) return false;
+	world.streamedFrom.resize(heads);
+	for (auto& at : world.streamedFrom) {
+		if (in.getBool()) at = getCoord(in);
+	}
+	world.recountKeepers();
+	return !in.failed();
+}
+
+static void writeGameFields(ByteWriter& out, const Game& game) {
+	out.put(game.ticks);
+	out.put(game.timeElapsed);
+	out.put((uint8_t) game.state);
+	out.put(game.clock.step);
+	out.put(game.clock.maxSubsteps);
+	out.put(game.clock.accumulator);
+}
+
+// false on a state or clock the game couldn't have been in
+static bool readGameFields(ByteReader& in, Game& game) {
+	game.ticks = in.get<uint64_t>();
+	game.timeElapsed = in.getDouble();
+	uint8_t state = in.get<uint8_t>();
+	game.clock.step = in.getDouble();
+	game.clock.maxSubsteps = in.get<int>();
+	game.clock.accumulator = in.getDouble();
+	if (in.failed() || state > (uint8_t) State::Overing) return false;
+
+	game.state = (State) state;
+	// a step of 0 or NaN never lets the accumulator drain
+	return std::isfinite(game.clock.step) && game.clock.step > 0.0 && game.clock.maxSubsteps >= 1;
+}
+
+static void writeSnakes(ByteWriter& out, const Game& game) {
+	out.putVarint(game.snakes.size());
+	for (size_t i = 0; i < game.snakes.size(); ++i) {
+		out.put(game.lost[i]);
+		writeSnake(out, game.snakes[i]);
+	}
+}
+
+static bool readSnakes(ByteReader& in, Game& game) {
+	uint64_t count = in.getVarint();
+	// at least a lose code and a snake's fixed fields each, the player is snake 0 so there's always one
+	if (count < 1 || !fits(in, count, 80)) return false;
+
+	game.snakes.assign(count, Snake());
+	game.lost.assign(count, LoseCode::None);
+	for (size_t i = 0; i < count; ++i) {
+		game.lost[i] = in.get<LoseCode>();
+		if (!readSnake(in, game.snakes[i])) return false;
+	}
+	game.sweep.clear();
+	return !in.failed();
+}
+
+void writeGame(ByteWriter& out, const Game& game) {
+	out.put(snapshotVersion);
+	writeGameFields(out, game);
+	writeWorld(out, game.world);
+	writeSnakes(out, game);
+}
+
+bool readGame(ByteReader& in, Game& game) {
+	if (in.get<uint32_t>() != snapshotVersion) return false;
+
+	if (!readGameFields(in, game) || !readWorld(in, game.world)) return false;
+	return readSnakes(in, game);
+}
+
+std::optional<uint64_t> peekGameTicks(ByteReader in) {
+	if (in.get<uint32_t>() != snapshotVersion) return std::nullopt;
+
+	uint64_t ticks = in.get<uint64_t>();
+	if (in.failed()) return std::nullopt;
+	return ticks;
+}
+
+// the object array is copied as is, so its layout is part of the format
+static_assert(std::is_trivially_copyable_v<ItemObj> && sizeof(ItemObj) == 20 && sizeof(Item) == 4);
+
+template <class T>
+static void putAligned(ByteWriter& out, const std::vector<T>& values) {
+	out.align(8);
+	out.putArray(std::span<const T>(values));
+}
+
+template <class T>
+static bool getAligned(ByteReader& in, std::vector<T>& values, size_t count) {
+	in.align(8);
+	return in.getArray(values, count);
+}
+
+static void putObjects(ByteWriter& out, const std::vector<ItemObj>& objects) {
+	out.align(8);
+	if constexpr (std::endian::native == std::endian::little) {
+		out.putBytes({ (const uint8_t*) objects.data(), objects.size() * sizeof(ItemObj) });
+	} else {
+		for (const auto& object : objects) {
+			out.put(object.pos);
+			out.put(object.radius);
+			out.put((uint32_t) object.item);
+		}
+	}
+}
+
+static bool getObjects(ByteReader& in, std::vector<ItemObj>& objects, size_t count) {
+	in.align(8);
+	auto raw = in.getBytes(count > SIZE_MAX / sizeof(ItemObj) ? SIZE_MAX : count * sizeof(ItemObj));
+	if (in.failed()) return false;
+
+	if constexpr (std::endian::native == std::endian::little) {
+		objects.resize(count);
+		if (count > 0) std::memcpy(objects.data(), raw.data(), raw.size());
+	} else {
+		ByteReader fields(raw);
+		objects.clear();
+		for (size_t i = 0; i < count; ++i) {
+			ItemObj object{};
+			object.pos = fields.getVec3();
+			object.radius = fields.getFloat();
+			object.item = (Item) fields.get<uint32_t>();
+			objects.push_back(object);
+		}
+	}
+	return true;
+}
+
+static void putImageCoord(ByteWriter& out, glm::ivec3 coord) {
+	out.put((int32_t) coord.x);
+	out.put((int32_t) coord.y);
+	out.put((int32_t) coord.z);
+}
+
+static glm::ivec3 getImageCoord(ByteReader& in) {
+	int x = in.get<int32_t>();
+	int y = in.get<int32_t>();
+	return glm::ivec3(x, y, in.get<int32_t>());
+}
+
+void writeWorldImage(ByteWriter& out, const World& world) {
+	size_t count = world.objects.size();
+	writeWorldHead(out, world);
+	out.put((uint64_t) count);
+
+	putObjects(out, world.objects);
+	putAligned(out, world.foods.x);
+	putAligned(out, world.foods.y);
+	putAligned(out, world.foods.z);
+	putAligned(out, world.foods.radius);
+	putAligned(out, world.foods.type);
+
+	out.align(8);
+	out.put((uint64_t) world.freeSlots.size());
+	putAligned(out, world.freeSlots);
+
+	out.align(8);
+	out.put((uint64_t) world.chunks.size());
+	for (const auto& chunk : world.chunks) {
+		out.align(8);
+		putImageCoord(out, chunk->coord);
+		out.put((uint32_t) chunk->dirty);
+		out.put((uint64_t) chunk->slots.size());
+		putAligned(out, chunk->slots);
+
+		const auto& occupancy = chunk->occupancy;
+		out.align(8);
+		out.put((uint64_t) occupancy.freeCells);
+		putAligned(out, occupancy.occupied);
+		putAligned(out, occupancy.freeBits);
+		putAligned(out, occupancy.tree);
+
+		// the cells flattened, offsets[i] to offsets[i + 1] are cell i's indices in the order they had
+		const auto& grid = chunk->grid;
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> indices;
+		offsets.reserve(grid.cells.size() + 1);
+		for (const auto& cell : grid.cells) {
+			offsets.push_back((uint32_t) indices.size());
+			indices.insert(indices.end(), cell.begin(), cell.end());
+		}
+		offsets.push_back((uint32_t) indices.size());
+
+		out.align(8);
+		out.put(grid.margin);
+		out.put((uint32_t) indices.size());
+		putAligned(out, offsets);
+		putAligned(out, indices);
+	}
+
+	auto keys = storedKeys(world);
+	out.align(8);
+	out.put((uint64_t) keys.size());
+	for (uint64_t key : keys) {
+		const auto& foods = world.stored.at(key);
+		out.align(8);
+		putImageCoord(out, Chunk::unkey(key));
+		out.put((uint32_t) 0);
+		out.put((uint64_t) foods.size());
+		putObjects(out, foods);
+	}
+
+	out.align(8);
+	out.put((uint64_t) world.streamedFrom.size());
+	for (const auto& at : world.streamedFrom) {
+		out.put((int32_t) at.has_value());
+		putImageCoord(out, at.value_or(glm::ivec3(0)));
+	}
+}
+
+bool readWorldImage(ByteReader& in, World& world) {
+	if (!readWorldHead(in, world)) return false;
+	uint64_t count = in.get<uint64_t>();
+	if (in.failed() || count > UINT32_MAX) return false;
+
+	auto& foods = world.foods;
+	if (!getObjects(in, world.objects, count) || !getAligned(in, foods.x, count) || !getAligned(in, foods.y, count)
+		|| !getAligned(in, foods.z, count) || !getAligned(in, foods.radius, count) || !getAligned(in, foods.type, count)) return false;
+	if (!knownItems(world.objects)
+		|| !std::all_of(foods.type.begin(), foods.type.end(), [](uint8_t type) { return type <= (uint8_t) Item::None; })) return false;
+
+	in.align(8);
+	uint64_t freeCount = in.get<uint64_t>();
+	if (in.failed() || freeCount > count || !getAligned(in, world.freeSlots, freeCount) || !allBelow(world.freeSlots, count)) return false;
+
+	in.align(8);
+	uint64_t chunkCount = in.get<uint64_t>();
+	if (!fits(in, chunkCount, 8)) return false;
+	for (uint64_t i = 0; i < chunkCount; ++i) {
+		in.align(8);
+		glm::ivec3 coord = getImageCoord(in);
+		bool dirty = in.get<uint32_t>() != 0;
+		uint64_t slots = in.get<uint64_t>();
+		Chunk* chunk = addChunk(world, coord, dirty);
+		if (in.failed() || chunk == nullptr || slots > count || !getAligned(in, chunk->slots, slots) || !allBelow(chunk->slots, count)) return false;
+
+		auto& occupancy = chunk->occupancy;
+		in.align(8);
+		size_t freeCells = (size_t) in.get<uint64_t>();
+		if (!getAligned(in, occupancy.occupied, OccupancyMap::wordCount) || !getAligned(in, occupancy.freeBits, OccupancyMap::wordCount)
+			|| !getAligned(in, occupancy.tree, OccupancyMap::wordCount + 1)) return false;
+		// no free cell is occupied or past the last cell, the counts are rebuilt from the bits rather than trusted
+		constexpr size_t tail = OccupancyMap::cellCount % 64;
+		if (tail != 0 && (occupancy.freeBits.back() >> tail) != 0) return false;
+		for (size_t w = 0; w < OccupancyMap::wordCount; ++w) {
+			if ((occupancy.freeBits[w] & occupancy.occupied[w]) != 0) return false;
+		}
+		occupancy.rebuildTree();
+		if (occupancy.freeCells != freeCells) return false;
+
+		auto& grid = chunk->grid;
+		in.align(8);
+		float margin = in.getFloat();
+		uint32_t indexCount = in.get<uint32_t>();
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> indices;
+		size_t cellCount = grid.cells.size();
+		if (in.failed() || indexCount > count) return false;
+		if (!getAligned(in, offsets, cellCount + 1) || !getAligned(in, indices, indexCount)) return false;
+		// ascending from 0 to indexCount, so every cell's run is inside indices
+		if (offsets.front() != 0 || offsets.back() != indexCount || !std::is_sorted(offsets.begin(), offsets.end())
+			|| !allBelow(indices, count)) return false;
+
+		for (size_t c = 0; c < cellCount; ++c) {
+			grid.cells[c].assign(indices.begin() + offsets[c], indices.begin() + offsets[c + 1]);
+		}
+		grid.margin = margin;
+	}
+
+	in.align(8);
+	uint64_t storedCount = in.get<uint64_t>();
+	if (!fits(in, storedCount, 24)) return false;
+	for (uint64_t i = 0; i < storedCount; ++i) {
+		in.align(8);
+		uint64_t key = Chunk::key(getImageCoord(in));
+		in.get<uint32_t>();
+		uint64_t foodCount = in.get<uint64_t>();
+		if (in.failed() || !getObjects(in, world.stored[key], foodCount) || !knownItems(world.stored[key])) return false;
+	}
+
+	in.align(8);
+	uint64_t heads = in.get<uint64_t>();
+	if (!fits(in, heads, 16)) return false;
+	world.streamedFrom.resize(heads);
+	for (auto& at : world.streamedFrom) {
+		bool has = in.get<int32_t>() != 0;
+		glm::ivec3 coord = getImageCoord(in);
+		if (has) at = coord;
+	}
+	world.recountKeepers();
+	return !in.failed();
+}
+
+void writeGameImage(ByteWriter& out, const Game& game) {
+	out.putBytes({ (const uint8_t*) imageMagic, 4 });
+	out.put(imageVersion);
+	out.put(snapshotVersion);
+	writeGameFields(out, game);
+	writeWorldImage(out, game.world);
+	writeSnakes(out, game);
+}
+
+bool readGameImage(std::span<const uint8_t> bytes, Game& game) {
+	ByteReader in(bytes);
+	auto magic = in.getBytes(4);
+	if (magic.size() != 4 || std::memcmp(magic.data(), imageMagic, 4) != 0) return false;
+	if (in.get<uint32_t>() != imageVersion || in.get<uint32_t>() != snapshotVersion) return false;
+
+	if (!readGameFields(in, game) || !readWorldImage(in, game.world)) return false;
+	return readSnakes(in, game);
+}
+
+bool saveGameImage(const std::string& path, const Game& game) {
+	ByteWriter out;
+	writeGameImage(out, game);
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write((const char*) out.bytes.data(), (std::streamsize) out.size());
+	return file.good();
+}
+
+bool loadGameImage(const std::string& path, Game& game) {
+	MappedFile file;
+	if (!file.open(path)) return false;
+	return readGameImage(file.bytes(), game);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <optional>
+
+#include "ByteStream.hpp"
+
+struct Game;
+struct World;
+class Snake;
+
+// complete simulation state, enough to carry on tick for tick as if nothing happened
+// only what can't be derived is stored, grids, lanes and the occupancy map are rebuilt on read
+// the read functions return false on truncated or foreign data, the target is left half written in that case
+
+constexpr uint32_t snapshotVersion = 2;
+
+void writeSnake(ByteWriter& out, const Snake& snake);
+bool readSnake(ByteReader& in, Snake& snake);
+
+void writeWorld(ByteWriter& out, const World& world);
+bool readWorld(ByteReader& in, World& world);
+
+void writeGame(ByteWriter& out, const Game& game);
+bool readGame(ByteReader& in, Game& game);
+
+// Game::ticks of a game snapshot without reading the rest, in is taken by value and left where it was
+std::optional<uint64_t> peekGameTicks(ByteReader in);
+
+// game images hold the same state laid out the way it sits in memory, so loading one is a memcpy per array
+// instead of rebuilding the grids, lanes and occupancy maps, e.g. for restarting into a prepared million food arena
+//
+// layout, all little endian:
+//   header  "WSIM", u32 image version, u32 snapshot version
+//   game    the fixed Game fields as in writeGame
+//   world   arena settings, then 8 byte aligned arrays: objects (pos, radius, u32 item), food lanes x y z radius
+//           type, free slots, then per loaded chunk its slots, occupancy words and grid offsets and indices,
+//           then the foods of stored chunks and the chunk each head was streamed from
+//   snakes  as in writeGame
+// big endian hosts read and write the same files, just element by element
+
+constexpr uint32_t imageVersion = 2;
+
+void writeWorldImage(ByteWriter& out, const World& world);
+bool readWorldImage(ByteReader& in, World& world);
+
+void writeGameImage(ByteWriter& out, const Game& game);
+bool readGameImage(std::span<const uint8_t> bytes, Game& game);
+
+// through a MappedFile, the file's pages go straight into the arrays
+bool saveGameImage(const std::string& path, const Game& game);
+bool loadGameImage(const std::string& path, Game& game);
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+class ByteWriter;
+class ByteReader;
+struct World;
+
+// uniform grid over one chunk, each cell buckets the indices of the objects whose centers fall inside it
+class SpatialGrid {
+	// game images copy the internals as they are, see Snapshot.hpp
+	friend void writeWorldImage(ByteWriter& out, const World& world);
+	friend bool readWorldImage(ByteReader& in, World& world);
+
+public:
+	static constexpr int cellSize = 4;
+	// edge length of the cube it covers, same as Chunk::size
+	static constexpr int extent = 32;
+	static constexpr int cellsPerAxis = extent / cellSize;
+
+private:
+	std::vector<std::vector<uint32_t>> cells;
+	// low corner of the cube
+	glm::vec3 origin;
+	// largest radius ever inserted, queries are widened by it so objects poking into a neighbouring cell are found
+	float margin;
+
+	static int cellCoord(float v, float origin) {
+		int c = (int) glm::floor((v - origin) / cellSize);
+		return glm::clamp(c, 0, cellsPerAxis - 1);
+	}
+
+	static size_t cellIndex(int x, int y, int z) {
+		return ((size_t) z * cellsPerAxis + y) * cellsPerAxis + x;
+	}
+
+	std::vector<uint32_t>& cellAt(glm::vec3 pos) {
+		return cells[cellIndex(cellCoord(pos.x, origin.x), cellCoord(pos.y, origin.y), cellCoord(pos.z, origin.z))];
+	}
+
+public:
+	explicit SpatialGrid(glm::vec3 origin) : cells((size_t) cellsPerAxis * cellsPerAxis * cellsPerAxis), origin(origin), margin(0.0f) {}
+
+	void insert(glm::vec3 pos, float radius, uint32_t index) {
+		margin = glm::max(margin, radius);
+		cellAt(pos).push_back(index);
+	}
+
+	// pos must be the position the index was inserted with
+	void remove(glm::vec3 pos, uint32_t index) {
+		auto& cell = cellAt(pos);
+		for (size_t i = 0; i < cell.size(); ++i) {
+			if (cell[i] == index) {
+				// order inside a cell doesn't matter
+				cell[i] = cell.back();
+				cell.pop_back();
+				return;
+			}
+		}
+	}
+
+	void clear() {
+		for (auto& cell : cells) {
+			cell.clear();
+		}
+		margin = 0.0f;
+	}
+
+	// clear and cover another cube, the cells keep their capacity
+	void reset(glm::vec3 origin) {
+		clear();
+		this->origin = origin;
+	}
+
+	// calls f(index) for every object that may overlap the sphere, stops early once f returns true
+	// the sphere can stick out of the cube, only the part inside is looked at
+	template <class F>
+	bool query(glm::vec3 pos, float radius, F&& f) const {
+		float reach = radius + margin;
+		int minX = cellCoord(pos.x - reach, origin.x), maxX = cellCoord(pos.x + reach, origin.x);
+		int minY = cellCoord(pos.y - reach, origin.y), maxY = cellCoord(pos.y + reach, origin.y);
+		int minZ = cellCoord(pos.z - reach, origin.z), maxZ = cellCoord(pos.z + reach, origin.z);
+
+		for (int z = minZ; z <= maxZ; ++z) {
+			for (int y = minY; y <= maxY; ++y) {
+				for (int x = minX; x <= maxX; ++x) {
+					for (uint32_t index : cells[cellIndex(x, y, z)]) {
+						if (f(index)) return true;
+					}
+				}
+			}
+		}
+		return false;
+	}
+};
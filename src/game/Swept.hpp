@@ -0,0 +1,92 @@
+#pragma once
+
+#include <optional>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+// continuous collision for a sphere moving in a straight line over one tick, from `from` to `from + motion`
+// a sphere of radius r against a shape is its centre against the shape grown by r, so these all trace a point
+// times are fractions of the tick, 0 - 1, and something already touching at the start is hit at 0
+
+// first time the point comes within radius of center
+[[nodiscard]]
+inline std::optional<float> sweepSphere(glm::vec3 from, glm::vec3 motion, glm::vec3 center, float radius) {
+	glm::vec3 oc = from - center;
+	float c = glm::dot(oc, oc) - radius * radius;
+	if (c <= 0.0f) return 0.0f;
+
+	float a = glm::dot(motion, motion);
+	float b = glm::dot(oc, motion);
+	// standing still or heading away
+	if (a == 0.0f || b >= 0.0f) return std::nullopt;
+
+	float h = b * b - a * c;
+	if (h < 0.0f) return std::nullopt;
+
+	float t = (-b - glm::sqrt(h)) / a;
+	if (t > 1.0f) return std::nullopt;
+	return t;
+}
+
+// first time the point comes within radius of the segment s1 - s2
+// https://iquilezles.org/articles/intersectors/ (capsule), with the ends split out so a parallel ray can't divide by 0
+[[nodiscard]]
+inline std::optional<float> sweepCapsule(glm::vec3 from, glm::vec3 motion, glm::vec3 s1, glm::vec3 s2, float radius) {
+	glm::vec3 ba = s2 - s1;
+	float baba = glm::dot(ba, ba);
+	if (baba == 0.0f) return sweepSphere(from, motion, s1, radius);
+
+	std::optional<float> first;
+	auto consider = [&](std::optional<float> t) {
+		if (t && (!first || *t < *first)) first = t;
+	};
+
+	// the round ends
+	consider(sweepSphere(from, motion, s1, radius));
+	consider(sweepSphere(from, motion, s2, radius));
+
+	// already inside the side
+	glm::vec3 oa = from - s1;
+	float baoa = glm::dot(ba, oa);
+	if (baoa > 0.0f && baoa < baba && glm::dot(oa, oa) * baba - baoa * baoa <= radius * radius * baba) return 0.0f;
+
+	// the side, in world units along the normalised motion
+	float len = glm::length(motion);
+	if (len == 0.0f) return first;
+	glm::vec3 rd = motion / len;
+
+	float bard = glm::dot(ba, rd);
+	float a = baba - bard * bard;
+	float b = baba * glm::dot(rd, oa) - baoa * bard;
+	float c = baba * glm::dot(oa, oa) - baoa * baoa - radius * radius * baba;
+
+	// moving along the axis only ever reaches an end
+	if (a <= 1e-6f * baba) return first;
+
+	float h = b * b - a * c;
+	if (h < 0.0f) return first;
+
+	// starting inside the infinite cylinder gives t < 0, then only the ends are left to hit
+	float t = (-b - glm::sqrt(h)) / a;
+	float y = baoa + t * bard;
+	if (t >= 0.0f && t <= len && y > 0.0f && y < baba) consider(t / len);
+
+	return first;
+}
+
+// first time the point gets further than half from the origin on any axis
+[[nodiscard]]
+inline std::optional<float> sweepWalls(glm::vec3 from, glm::vec3 motion, float half) {
+	glm::vec3 to = from + motion;
+	std::optional<float> first;
+
+	for (int axis = 0; axis < 3; ++axis) {
+		if (glm::abs(to[axis]) <= half) continue;
+
+		float wall = to[axis] > 0.0f ? half : -half;
+		// already out if it isn't moving along this axis
+		float t = motion[axis] == 0.0f ? 0.0f : glm::clamp((wall - from[axis]) / motion[axis], 0.0f, 1.0f);
+		if (!first || t < *first) first = t;
+	}
+	return first;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// hands the newest T from one writer thread to one reader thread without either ever waiting on the other
+// the writer fills writing() and publishes it, the reader takes whatever was published last and keeps reading() until
+// it takes again, the third slot sits between them so neither touches what the other is holding
+template <class T>
+class TripleBuffer {
+private:
+	static constexpr uint8_t indexMask = 3;
+	// set on the middle slot while the reader hasn't taken it
+	static constexpr uint8_t freshBit = 4;
+
+	std::array<T, 3> slots;
+	std::atomic<uint8_t> middle{ 1 };
+	// owned by the writer and the reader respectively
+	uint8_t back = 0;
+	uint8_t front = 2;
+
+public:
+	// writer side
+	[[nodiscard]] T& writing() { return slots[back]; }
+
+	// makes what was written the newest, whatever the reader left in the middle is what gets written next
+	void publish() {
+		back = middle.exchange(back | freshBit, std::memory_order_acq_rel) & indexMask;
+	}
+
+	// reader side, true if something was published since the last take, reading() is the newest either way
+	bool take() {
+		if (!(middle.load(std::memory_order_relaxed) & freshBit)) return false;
+		front = middle.exchange(front, std::memory_order_acq_rel) & indexMask;
+		return true;
+	}
+
+	[[nodiscard]] const T& reading() const { return slots[front]; }
+};
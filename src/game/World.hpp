@@ -1,19 +1,225 @@
 #pragma once
 
+#include <span>
+#include <memory>
 #include <vector>
+#include <utility>
+#include <functional>
 #include <random>
+#include <optional>
+#include <concepts>
+#include <algorithm>
+#include <unordered_map>
 #include "Object.hpp"
+#include "Random.hpp"
+#include "Parallel.hpp"
+#include "Chunk.hpp"
+#include "FoodStore.hpp"
+#include "Swept.hpp"
 
+// a cube of chunks around the origin, only the chunks near a head are in memory
+// chunk contents come from the seed and the chunk's coordinate, so a chunk nobody changed can be dropped and made again
 struct World {
+	// foods of every loaded chunk, slots of unloaded chunks are None until a chunk loading in reuses them
 	std::vector<ItemObj> objects;
-	std::random_device rd;
-	std::default_random_engine re;
+	// same objects split into lanes for batched scans
+	FoodStore foods;
+	// loaded chunks, chunkIndex finds them by key
+	std::vector<std::unique_ptr<Chunk>> chunks;
+	std::unordered_map<uint64_t, uint32_t> chunkIndex;
+	// unloaded chunks kept for the next ones to load into
+	std::vector<std::unique_ptr<Chunk>> spareChunks;
+	// foods of unloaded chunks that changed while they were loaded, regenerating would bring eaten food back
+	std::unordered_map<uint64_t, std::vector<ItemObj>> stored;
+	// None slots of objects, reused from the back
+	std::vector<uint32_t> freeSlots;
+	// chunk each head was in when it was last streamed, nullopt for heads that weren't yet
+	std::vector<std::optional<glm::ivec3>> streamedFrom;
+	// heads close enough to each chunk to keep it loaded, a chunk is unloaded when its count drops to 0
+	std::unordered_map<uint64_t, uint32_t> keepers;
+	uint64_t seed;
+	// respawns draw from their own stream so they don't shift when generation changes
+	CounterRng rng;
+	// the walls are at +-half on every axis, always a whole number of chunks
+	int half;
+	// foods generate spreads over every chunk of the arena, loaded or not
+	uint64_t foodTotal;
+	// chunks this close to a head's chunk get loaded, they go once no head's chunk is within a chunk more than that
+	float streamRadius;
+	// largest food radius, queries look this far into the neighbouring chunks
+	float margin;
+	// objects changed since the last takeChanges, each once, for whoever mirrors them, i.e. the renderer's gpu copy
+	std::vector<uint32_t> changed;
+	std::vector<uint8_t> changedMark;
+	// objects were replaced wholesale since the last takeChanges, nothing of a mirror can be kept
+	bool rebuilt;
 
-	World() : objects(), rd(), re(rd()) {};
+	static constexpr float foodRadius = 0.5f;
+	static constexpr uint64_t respawnStream = 1;
+	// a chunk generates from stream chunkStreams + its key
+	static constexpr uint64_t chunkStreams = 2;
+	static constexpr int defaultHalf = 64;
+	// positions stay exact integers up to 2^24, the lattice needs that
+	static constexpr int maxHalf = 1 << 23;
+	static constexpr float defaultStreamRadius = 128.0f;
+
+	World() : World(randomSeed()) {};
+	explicit World(uint64_t seed) :
+		objects(), foods(), chunks(), chunkIndex(), spareChunks(), stored(), freeSlots(), streamedFrom(), keepers(),
+		seed(seed), rng(seed, respawnStream), half(defaultHalf), foodTotal(0), streamRadius(defaultStreamRadius), margin(foodRadius),
+		changed(), changedMark(), rebuilt(true) {};
+
+	[[nodiscard]]
+	static uint64_t randomSeed() {
+		std::random_device rd;
+		return ((uint64_t) rd() << 32) | rd();
+	}
+
+	// restarts the respawn stream, doesn't touch what's already in the world
+	void reseed(uint64_t seed) {
+		this->seed = seed;
+		this->rng = CounterRng(seed, respawnStream);
+	}
+
+	// empties the world and changes its size, half is rounded up to a whole number of chunks
+	void resize(int half) {
+		clear();
+		int chunkHalf = (glm::clamp(half, 1, maxHalf) + Chunk::size - 1) / Chunk::size;
+		this->half = chunkHalf * Chunk::size;
+	}
+
+	[[nodiscard]] int chunksPerAxis() const { return 2 * half / Chunk::size; }
+
+	[[nodiscard]]
+	uint64_t chunkCount() const {
+		uint64_t n = (uint64_t) chunksPerAxis();
+		return n * n * n;
+	}
+
+	[[nodiscard]]
+	glm::ivec3 clampChunk(glm::ivec3 coord) const {
+		int lo = -half / Chunk::size;
+		return glm::clamp(coord, glm::ivec3(lo), glm::ivec3(-lo - 1));
+	}
+
+	[[nodiscard]]
+	bool inArena(glm::ivec3 coord) const {
+		return clampChunk(coord) == coord;
+	}
+
+	[[nodiscard]]
+	const Chunk* chunkAt(glm::ivec3 coord) const {
+		auto it = chunkIndex.find(Chunk::key(coord));
+		return it == chunkIndex.end() ? nullptr : chunks[it->second].get();
+	}
+
+	[[nodiscard]]
+	Chunk* chunkAt(glm::ivec3 coord) {
+		return const_cast<Chunk*>(std::as_const(*this).chunkAt(coord));
+	}
+
+	// calls f(chunk) for every loaded chunk the sphere reaches into, stops early once f returns true
+	template <class F>
+	bool forChunks(glm::vec3 pos, float radius, F&& f) const {
+		float reach = radius + margin;
+		glm::ivec3 lo = clampChunk(Chunk::coordOf(pos - reach));
+		glm::ivec3 hi = clampChunk(Chunk::coordOf(pos + reach));
+
+		for (int z = lo.z; z <= hi.z; ++z) {
+			for (int y = lo.y; y <= hi.y; ++y) {
+				for (int x = lo.x; x <= hi.x; ++x) {
+					const Chunk* chunk = chunkAt(glm::ivec3(x, y, z));
+					if (chunk != nullptr && f(*chunk)) return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	// grid cells a query for the sphere would visit if every chunk were loaded
+	[[nodiscard]]
+	double cellsTouched(glm::vec3 pos, float radius) const {
+		constexpr float cell = (float) SpatialGrid::cellSize;
+		float reach = radius + margin;
+		glm::vec3 lo = glm::floor(glm::max(pos - reach, glm::vec3((float) -half)) / cell);
+		glm::vec3 hi = glm::floor(glm::min(pos + reach, glm::vec3((float) half)) / cell);
+		glm::vec3 span = glm::max(hi - lo + 1.0f, glm::vec3(1.0f));
+		return (double) span.x * span.y * span.z;
+	}
+
+	// returns nullptr on failure, ignores None items
+	// only looks at the grid cells around obj so the cost doesn't depend on how many objects exist
+	[[nodiscard]]
+	ItemObj* checkCollision(const Object& obj, const Object* filter = nullptr) {
+		return const_cast<ItemObj*>(std::as_const(*this).checkCollision(obj, filter));
+	}
+
+	// read only, safe to call from several threads while nothing modifies the world
+	[[nodiscard]]
+	const ItemObj* checkCollision(const Object& obj, const Object* filter = nullptr) const {
+		// spheres covering a good part of the arena are cheaper to test with one pass over the lanes
+		if (cellsTouched(obj.pos, obj.radius) * 16 > (double) objects.size()) {
+			// filter is skipped by index, it may not be one of the objects at all
+			std::less<const Object*> before;
+			size_t skip = FoodStore::npos;
+			if (filter && !before(filter, objects.data()) && before(filter, objects.data() + objects.size())) {
+				skip = (size_t) (static_cast<const ItemObj*>(filter) - objects.data());
+			}
+			size_t hit = foods.firstHit(obj, skip);
+			return hit == FoodStore::npos ? nullptr : &objects[hit];
+		}
+
+		const ItemObj* hit = nullptr;
+		forChunks(obj.pos, obj.radius, [&](const Chunk& chunk) {
+			return chunk.grid.query(obj.pos, obj.radius, [&](uint32_t index) {
+				const auto& object = objects[index];
+				if (object.item == Item::None || &object == filter) return false;
+
+				if (obj.dist(object) <= 0.0) {
+					hit = &object;
+					return true;
+				}
+				return false;
+			});
+		});
+		return hit;
+	}
+
+	// calls f(index, t) for every object obj runs into while moving by motion, t is the fraction of the move it took
+	// read only like the const checkCollision, the order objects come in isn't the order they're reached
+	template <class F>
+	void sweepCollisions(const Object& obj, glm::vec3 motion, F&& f) const {
+		// everything the move can touch is inside the sphere around the path
+		Object bounds{ obj.pos + motion * 0.5f, glm::length(motion) * 0.5f + obj.radius };
+
+		auto test = [&](uint32_t index) {
+			const auto& object = objects[index];
+			if (object.item == Item::None) return;
+
+			auto t = sweepSphere(obj.pos, motion, object.pos, obj.radius + object.radius);
+			if (t) f(index, *t);
+		};
+
+		if (cellsTouched(bounds.pos, bounds.radius) * 16 > (double) objects.size()) {
+			std::vector<uint32_t> out;
+			foods.allHits(bounds, out);
+			for (uint32_t index : out) test(index);
+			return;
+		}
+
+		forChunks(bounds.pos, bounds.radius, [&](const Chunk& chunk) {
+			chunk.grid.query(bounds.pos, bounds.radius, [&](uint32_t index) {
+				test(index);
+				return false;
+			});
+			return false;
+		});
+	}
 
 	// returns nullptr on failure, ignores None items
 	// type T must have distance function that takes an Object as input
-	template <class T>
+	// shapes without a bounding sphere can't use the grid, so this is a full scan
+	template <class T> requires (!std::derived_from<T, Object>)
 	[[nodiscard]]
 	ItemObj* checkCollision(const T& obj, Object* filter = nullptr) {
 		for (auto& object : objects) {
@@ -24,22 +230,365 @@ struct World {
 		return nullptr;
 	}
 
+	// picks a uniformly random lattice cell of chunk that obj fits in, nullopt once the chunk is full
 	// collider is any object that implements collides(Object) aka. the snake
 	template <class T>
-	void moveObj(Object& obj, const T& collider) {
-		std::uniform_int_distribution<int> dist(-63, 63);
+	[[nodiscard]]
+	std::optional<glm::vec3> findFreePos(const Object& obj, const Chunk& chunk, const T& collider) {
+		// the snake only covers a sliver of the chunk, so a few draws almost always do it
+		constexpr int maxDraws = 16;
+		const auto& occupancy = chunk.occupancy;
+
+		auto fits = [&](size_t cell) {
+			Object candidate{ chunk.posOf(cell), obj.radius };
+			return checkCollision(candidate, &obj) == nullptr && !collider.collides(candidate);
+		};
 
+		if (occupancy.freeCount() == 0) return std::nullopt;
+
+		uint32_t free = (uint32_t) occupancy.freeCount();
+		for (int i = 0; i < maxDraws; ++i) {
+			size_t cell = occupancy.selectFree(rng.below(free));
+			if (fits(cell)) return chunk.posOf(cell);
+		}
+
+		// the snake is in the way of most of what's left, walk the free cells from a random one instead
+		size_t start = occupancy.selectFree(rng.below(free));
+		size_t cell = start;
 		do {
-			obj.pos = glm::vec3(dist(re), dist(re), dist(re));
-		} while (checkCollision(obj, &obj) != nullptr || collider.collides(obj));
+			if (fits(cell)) return chunk.posOf(cell);
+			cell = occupancy.nextFree(cell + 1 == OccupancyMap::cellCount ? 0 : cell + 1);
+		} while (cell != start);
+
+		return std::nullopt;
 	}
 
+	// obj must live in objects, it's moved somewhere else in its own chunk so chunks keep their food
+	// if there's no room left it becomes a None item
 	template <class T>
-	void placeFood(const T& collider) {
-		ItemObj food{ glm::vec3(0.0), 0.5, Item::Food };
+	void moveObj(ItemObj& obj, const T& collider) {
+		uint32_t index = (uint32_t) (&obj - objects.data());
+		Chunk& chunk = *chunkAt(Chunk::coordOf(obj.pos));
+
+		chunk.grid.remove(obj.pos, index);
+		chunk.occupancy.release(chunk.cellOf(obj.pos));
+		chunk.dirty = true;
+
+		auto pos = findFreePos(obj, chunk, collider);
+		if (pos) {
+			obj.pos = *pos;
+			chunk.grid.insert(obj.pos, obj.radius, index);
+			chunk.occupancy.occupy(chunk.cellOf(obj.pos));
+		} else {
+			obj.item = Item::None;
+		}
+		foods.set(index, obj);
+		markChanged(index);
+	}
+
+	// one more food in a random loaded chunk, returns false once every loaded chunk is full
+	template <class T>
+	bool placeFood(const T& collider) {
+		if (chunks.empty()) return false;
+
+		ItemObj food{ glm::vec3(0.0), foodRadius, Item::Food };
+		size_t start = rng.below((uint32_t) chunks.size());
+		for (size_t i = 0; i < chunks.size(); ++i) {
+			Chunk& chunk = *chunks[(start + i) % chunks.size()];
+			auto pos = findFreePos(food, chunk, collider);
+			if (!pos) continue;
 
-		moveObj(food, collider);
+			food.pos = *pos;
+			uint32_t slot = takeSlot();
+			chunk.slots.push_back(slot);
+			put(chunk, slot, food);
+			markChanged(slot);
+			chunk.dirty = true;
+			return true;
+		}
+		return false;
+	}
+
+	// clears the world and spreads n foods evenly over every chunk of the arena, returns how many are loaded
+	// only the chunks around heads are made now, the rest as heads come close
+	template <class T>
+	size_t generate(uint64_t seed, uint64_t n, std::span<const glm::vec3> heads, const T& collider, unsigned threads = 0) {
+		clear();
+		reseed(seed);
+		foodTotal = n;
+
+		stream(heads, collider, threads);
+		return foodCount();
+	}
+
+	// loads the chunks around every head and unloads the ones no head is near anymore
+	// heads[i] is the same snake from call to call, only heads that moved to another chunk since the last call cost anything
+	template <class T>
+	void stream(std::span<const glm::vec3> heads, const T& collider, unsigned threads = 0) {
+		std::vector<glm::ivec3> load;
+		if (streamedFrom.size() < heads.size()) streamedFrom.resize(heads.size());
 
-		objects.emplace_back(std::move(food));
+		for (size_t i = 0; i < heads.size(); ++i) {
+			glm::ivec3 coord = clampChunk(Chunk::coordOf(heads[i]));
+			if (streamedFrom[i] == coord) continue;
+
+			// the new neighbourhood first, so chunks both share stay loaded
+			keep(coord, &load);
+			if (streamedFrom[i]) release(*streamedFrom[i]);
+			streamedFrom[i] = coord;
+		}
+		// heads that are gone
+		for (size_t i = heads.size(); i < streamedFrom.size(); ++i) {
+			if (streamedFrom[i]) release(*streamedFrom[i]);
+		}
+		streamedFrom.resize(heads.size());
+
+		if (!load.empty()) loadChunks(load, collider, threads);
+	}
+
+	// calls f(coord, load) for every chunk in the arena a head in chunk at is near, load is whether it's close enough
+	// to be loaded, the rest only count towards staying loaded
+	template <class F>
+	void forStreamed(glm::ivec3 at, F&& f) const {
+		float keepRadius = streamRadius + Chunk::size;
+		int reach = (int) glm::ceil(keepRadius / Chunk::size);
+
+		for (int z = -reach; z <= reach; ++z) {
+			for (int y = -reach; y <= reach; ++y) {
+				for (int x = -reach; x <= reach; ++x) {
+					glm::ivec3 coord = at + glm::ivec3(x, y, z);
+					if (!inArena(coord)) continue;
+
+					float distance = Chunk::distance(at, coord);
+					if (distance <= keepRadius) f(coord, distance <= streamRadius);
+				}
+			}
+		}
+	}
+
+	// counts a head in chunk at, chunks it should load that aren't go in load if it's given
+	void keep(glm::ivec3 at, std::vector<glm::ivec3>* load) {
+		forStreamed(at, [&](glm::ivec3 coord, bool near) {
+			keepers[Chunk::key(coord)]++;
+			if (load != nullptr && near && chunkAt(coord) == nullptr) load->push_back(coord);
+		});
+	}
+
+	// takes a head in chunk at out of the counts, chunks nobody is near anymore are unloaded
+	void release(glm::ivec3 at) {
+		forStreamed(at, [&](glm::ivec3 coord, bool) {
+			uint64_t key = Chunk::key(coord);
+			auto it = keepers.find(key);
+			if (it == keepers.end() || --it->second > 0) return;
+
+			keepers.erase(it);
+			auto loaded = chunkIndex.find(key);
+			if (loaded != chunkIndex.end()) unload(loaded->second);
+		});
+	}
+
+	// keepers from streamedFrom alone, for after the chunks were restored some other way
+	void recountKeepers() {
+		keepers.clear();
+		for (const auto& at : streamedFrom) {
+			if (at) keep(*at, nullptr);
+		}
+	}
+
+	// how many foods chunk coord is generated with, foodTotal split evenly with the remainder going to the lowest chunks
+	[[nodiscard]]
+	uint64_t foodsIn(glm::ivec3 coord) const {
+		uint64_t per = (uint64_t) chunksPerAxis();
+		glm::ivec3 c = coord + half / Chunk::size;
+		uint64_t linear = ((uint64_t) c.z * per + (uint64_t) c.y) * per + (uint64_t) c.x;
+		return foodTotal / chunkCount() + (linear < foodTotal % chunkCount() ? 1 : 0);
+	}
+
+	[[nodiscard]]
+	size_t foodCount() const {
+		return (size_t) std::count_if(objects.begin(), objects.end(), [](const ItemObj& obj) { return obj.item == Item::Food; });
+	}
+
+	uint32_t takeSlot() {
+		if (!freeSlots.empty()) {
+			uint32_t slot = freeSlots.back();
+			freeSlots.pop_back();
+			return slot;
+		}
+
+		ItemObj empty{ glm::vec3(0.0f), 0.0f, Item::None };
+		objects.push_back(empty);
+		foods.push(empty);
+		return (uint32_t) (objects.size() - 1);
+	}
+
+	void freeSlot(uint32_t slot) {
+		ItemObj empty{ glm::vec3(0.0f), 0.0f, Item::None };
+		objects[slot] = empty;
+		foods.set(slot, empty);
+		markChanged(slot);
+		freeSlots.push_back(slot);
+	}
+
+	// writes food to one of chunk's slots and indexes it, only touches chunk and the slot
+	// doesn't mark the slot changed, loadChunks puts from several threads at once
+	void put(Chunk& chunk, uint32_t slot, const ItemObj& food) {
+		objects[slot] = food;
+		foods.set(slot, food);
+		if (food.item == Item::None) return;
+
+		chunk.grid.insert(food.pos, food.radius, slot);
+		chunk.occupancy.occupy(chunk.cellOf(food.pos));
+	}
+
+	// fills the chunk's slots from its own stream, draws that land on collider are skipped
+	template <class T>
+	void generateChunk(Chunk& chunk, const T& collider) {
+		CounterRng draws(seed, chunkStreams + Chunk::key(chunk.coord));
+		size_t placed = 0;
+		// a snake lying across the chunk can eat a lot of draws, don't chase it forever
+		size_t maxDraws = chunk.slots.size() * 4 + 64;
+
+		for (size_t k = 0; k < maxDraws && placed < chunk.slots.size(); ++k) {
+			uint32_t free = (uint32_t) chunk.occupancy.freeCount();
+			if (free == 0) break;
+
+			glm::vec3 pos = chunk.posOf(chunk.occupancy.selectFree(draws.below(free)));
+			if (collider.collides(Object{ pos, foodRadius })) continue;
+
+			put(chunk, chunk.slots[placed++], ItemObj{ pos, foodRadius, Item::Food });
+		}
+	}
+
+	// brings the chunks in, restored ones get the foods they had, the others are generated across threads
+	// each chunk only writes its own slots so the result doesn't depend on the thread count
+	template <class T>
+	void loadChunks(const std::vector<glm::ivec3>& coords, const T& collider, unsigned threads = 0) {
+		size_t first = chunks.size();
+		std::vector<std::vector<ItemObj>> restored;
+
+		for (glm::ivec3 coord : coords) {
+			uint64_t key = Chunk::key(coord);
+			if (chunkIndex.contains(key)) continue;
+
+			Chunk& chunk = addChunk(coord);
+			auto it = stored.find(key);
+			if (it != stored.end()) {
+				restored.push_back(std::move(it->second));
+				stored.erase(it);
+				chunk.dirty = true;
+			} else {
+				restored.emplace_back();
+			}
+
+			size_t count = chunk.dirty ? restored.back().size() : foodsIn(coord);
+			for (size_t i = 0; i < count; ++i) {
+				chunk.slots.push_back(takeSlot());
+			}
+		}
+
+		parallelFor(chunks.size() - first, threads, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				Chunk& chunk = *chunks[first + i];
+				if (!chunk.dirty) {
+					generateChunk(chunk, collider);
+					continue;
+				}
+				for (size_t k = 0; k < chunk.slots.size(); ++k) {
+					put(chunk, chunk.slots[k], restored[i][k]);
+				}
+			}
+		});
+
+		// slots generation couldn't fill go back
+		for (size_t i = first; i < chunks.size(); ++i) {
+			auto& slots = chunks[i]->slots;
+			for (uint32_t slot : slots) {
+				markChanged(slot);
+				if (objects[slot].item == Item::None) freeSlots.push_back(slot);
+			}
+			std::erase_if(slots, [&](uint32_t slot) { return objects[slot].item == Item::None; });
+			for (uint32_t slot : slots) {
+				margin = glm::max(margin, objects[slot].radius);
+			}
+		}
+	}
+
+	// drops chunks[i], its foods are kept if they changed
+	void unload(size_t i) {
+		Chunk& chunk = *chunks[i];
+		uint64_t key = Chunk::key(chunk.coord);
+
+		if (chunk.dirty) {
+			auto& keep = stored[key];
+			keep.clear();
+			for (uint32_t slot : chunk.slots) {
+				if (objects[slot].item != Item::None) keep.push_back(objects[slot]);
+			}
+		}
+		for (uint32_t slot : chunk.slots) {
+			freeSlot(slot);
+		}
+
+		chunkIndex.erase(key);
+		spareChunks.push_back(std::move(chunks[i]));
+		if (i + 1 != chunks.size()) {
+			chunks[i] = std::move(chunks.back());
+			chunkIndex[Chunk::key(chunks[i]->coord)] = (uint32_t) i;
+		}
+		chunks.pop_back();
+	}
+
+	// an empty loaded chunk at coord, which must not be loaded yet
+	Chunk& addChunk(glm::ivec3 coord) {
+		chunkIndex.emplace(Chunk::key(coord), (uint32_t) chunks.size());
+		if (spareChunks.empty()) return *chunks.emplace_back(std::make_unique<Chunk>(coord));
+
+		auto& chunk = chunks.emplace_back(std::move(spareChunks.back()));
+		spareChunks.pop_back();
+		chunk->reset(coord);
+		return *chunk;
+	}
+
+	void clear() {
+		objects.clear();
+		foods.clear();
+		for (auto& chunk : chunks) {
+			spareChunks.push_back(std::move(chunk));
+		}
+		chunks.clear();
+		chunkIndex.clear();
+		stored.clear();
+		freeSlots.clear();
+		streamedFrom.clear();
+		keepers.clear();
+		margin = foodRadius;
+		changed.clear();
+		changedMark.clear();
+		rebuilt = true;
+	}
+
+	void markChanged(uint32_t index) {
+		if (changedMark.size() <= index) changedMark.resize(objects.size());
+		if (changedMark[index]) return;
+
+		changedMark[index] = 1;
+		changed.push_back(index);
+	}
+
+	// indices of the objects changed since the last call go to out, in no particular order
+	// returns true instead if objects was replaced wholesale, all of them have to be taken again then
+	[[nodiscard]]
+	bool takeChanges(std::vector<uint32_t>& out) {
+		out.clear();
+		bool all = rebuilt;
+		if (!all) out.swap(changed);
+		for (uint32_t index : out) {
+			changedMark[index] = 0;
+		}
+		changed.clear();
+		if (all) changedMark.assign(changedMark.size(), 0);
+		rebuilt = false;
+		return all;
 	}
-};
\ No newline at end of file
+};
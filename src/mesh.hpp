@@ -1,223 +1,184 @@
 #pragma once
 
-#include <vector>
+#include <map>
 #include <array>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <glm/glm.hpp>
-#include "RenderEngine.hpp"
-
-template <size_t N> [[nodiscard]]
-std::array<glm::vec3, N / 3> createNormals(const std::array<glm::vec3, N>& mesh) {
 
-	std::array<glm::vec3, N / 3> out{};
-
-	for (int i = 0; i < N / 3; ++i) {
-		glm::vec3 a = mesh[i * 3];
-		glm::vec3 b = mesh[i * 3 + 1];
-		glm::vec3 c = mesh[i * 3 + 2];
-
-		out[i] = glm::normalize(glm::cross(b - a, c - a));
+// the fill functions append vertex or instance data to anything with a char8_t* pointer and a byte size,
+// PersistentMappedBuffer in the game, plain memory in the benchmarks
+
+// colors SnakeBody.vert has, by index
+enum class SnakeColor : uint8_t {
+	Player,
+	Other
+};
+
+// bytes fillSnakePoints writes per point, a vec4 of the point and the SnakeColor of the segment to the next one,
+// -1 after the last point so segments never join two snakes
+constexpr size_t snakePointSize = 16;
+
+// only the points go to the gpu, SnakeCull.comp picks the segments in view and SnakeBody.vert builds their boxes
+// points is any indexable sequence, e.g. Snake::interpolated
+template <class Points, class Buffer>
+void fillSnakePoints(const Points& points, Buffer& buffer, SnakeColor color) {
+	for (size_t i = 0; i < points.size(); ++i) {
+		glm::vec4 point(points[i], i + 1 < points.size() ? (float) color : -1.0f);
+		memcpy(buffer.pointer + buffer.size, &point, snakePointSize);
+		buffer.size += snakePointSize;
 	}
-
-	return out;
 }
 
-template <class T> [[nodiscard]]
-std::vector<glm::vec3> createNormals(const T& mesh) {
-
-	std::vector<glm::vec3> out;
-	out.reserve(mesh.size() / 3);
-
-	for (int i = 0; i < mesh.size() / 3; ++i) {
-		glm::vec3 A = mesh[i * 3];
-		glm::vec3 B = mesh[i * 3 + 1];
-		glm::vec3 C = mesh[i * 3 + 2];
-
-		out.emplace_back(glm::normalize(glm::cross(B - A, C - A)));
-	}
+// vertex of the static meshes, 12 bytes, positions as normalized shorts so meshes have to fit in [-1, 1],
+// normals as normalized 10:10:10:2
+struct PackedVertex {
+	int16_t pos[4];
+	uint32_t normal;
+};
+static_assert(sizeof(PackedVertex) == 12);
 
-	return out;
-}
-
-//creates an axis-aligned rectangular prism given two points
 [[nodiscard]]
-constexpr std::array<glm::vec3, 36> createRectMesh(const glm::vec3& p1, const glm::vec3& p2, float sidelen) {
-	float halflen = sidelen * 0.5f;
-
-	float minX = glm::min(p1.x, p2.x) - halflen;
-	float minY = glm::min(p1.y, p2.y) - halflen;
-	float minZ = glm::min(p1.z, p2.z) - halflen;
-
-	float maxX = glm::max(p1.x, p2.x) + halflen;
-	float maxY = glm::max(p1.y, p2.y) + halflen;
-	float maxZ = glm::max(p1.z, p2.z) + halflen;
-
-	glm::vec3 vertA(minX, minY, minZ);
-	glm::vec3 vertB(maxX, minY, minZ);
-	glm::vec3 vertC(minX, maxY, minZ);
-	glm::vec3 vertD(maxX, maxY, minZ);
-
-	glm::vec3 vertG(minX, minY, maxZ);
-	glm::vec3 vertH(maxX, minY, maxZ);
-	glm::vec3 vertE(minX, maxY, maxZ);
-	glm::vec3 vertF(maxX, maxY, maxZ);
-
-	return {
-		vertA, vertD, vertB,
-		vertA, vertC, vertD,
-
-		vertB, vertF, vertH,
-		vertB, vertD, vertF,
-
-		vertC, vertF, vertD,
-		vertC, vertE, vertF,
-
-		vertA, vertB, vertH,
-		vertA, vertH, vertG,
-
-		vertA, vertG, vertE,
-		vertA, vertE, vertC,
-
-		vertG, vertH, vertF,
-		vertG, vertF, vertE
-	};
+inline int16_t packSnorm16(float value) {
+	return (int16_t) std::lround(glm::clamp(value, -1.0f, 1.0f) * 32767.0f);
 }
 
+// for GL_INT_2_10_10_10_REV, w left 0
 [[nodiscard]]
-std::vector<glm::vec3> createSnakeMesh(const std::vector<glm::vec3>& points, float sidelen) {
-	if (points.size() < 2) return {};
-
-	std::vector<glm::vec3> out;
-	out.reserve(points.size() * 36);
-
-	for (int i = 1; i < points.size(); ++i) {
-		auto p1 = points[i - 1];
-		auto p2 = points[i];
-
-		glm::vec3 dir = normalize(p2 - p1);
-		glm::vec3 endp = p2;
-
-		auto verts = createRectMesh(p1, endp, sidelen);
-		for (auto&& vert : verts) {
-			out.emplace_back(vert);
-		}
-	}
-
-	return out;
-}
-
-void fillSnakeMeshInterleaved(const std::vector<glm::vec3>& points, PersistentMappedBuffer& buffer, float sidelen, glm::vec4 color) {
-	auto snakeMesh = createSnakeMesh(points, sidelen);
-	auto normals = createNormals(snakeMesh);
-
-	for (int i = 0; i < snakeMesh.size(); i += 3) {
-		int nIndex = i / 3;
-
-		auto& curA = snakeMesh[i];
-		memcpy(buffer.pointer + buffer.size, &curA, sizeof(glm::vec3));
-		buffer.size += sizeof(glm::vec3);
-		memcpy(buffer.pointer + buffer.size, &normals[nIndex], sizeof(glm::vec3));
-		buffer.size += sizeof(glm::vec3);
-		memcpy(buffer.pointer + buffer.size, &color, sizeof(glm::vec4));
-		buffer.size += sizeof(glm::vec4);
-
-		auto& curB = snakeMesh[i + 1];
-		memcpy(buffer.pointer + buffer.size, &curB, sizeof(glm::vec3));
-		buffer.size += sizeof(glm::vec3);
-		memcpy(buffer.pointer + buffer.size, &normals[nIndex], sizeof(glm::vec3));
-		buffer.size += sizeof(glm::vec3);
-		memcpy(buffer.pointer + buffer.size, &color, sizeof(glm::vec4));
-		buffer.size += sizeof(glm::vec4);
-
-		auto& curC = snakeMesh[i + 2];
-		memcpy(buffer.pointer + buffer.size, &curC, sizeof(glm::vec3));
-		buffer.size += sizeof(glm::vec3);
-		memcpy(buffer.pointer + buffer.size, &normals[nIndex], sizeof(glm::vec3));
-		buffer.size += sizeof(glm::vec3);
-		memcpy(buffer.pointer + buffer.size, &color, sizeof(glm::vec4));
-		buffer.size += sizeof(glm::vec4);
-	}
+inline uint32_t packNormal(const glm::vec3& normal) {
+	auto pack = [](float value) { return (uint32_t) std::lround(glm::clamp(value, -1.0f, 1.0f) * 511.0f) & 0x3FF; };
+	return pack(normal.x) | pack(normal.y) << 10 | pack(normal.z) << 20;
 }
 
+// float to GL_HALF_FLOAT, rounded to nearest, anything too small for a normal half is 0 and too big infinity
 [[nodiscard]]
-consteval std::array<glm::vec3, 20 * 3> createFoodMesh() {
-	constexpr float a = 0.52573f;
-	constexpr float b = 0.85065f;
-
-	// adapted from https://github.com/anishagartia/Icosahedron_OpenGL
-	constexpr std::array<glm::vec3, 12> verts = {
-		glm::vec3{ -a, 0.0f, b }, { a, 0.0, b }, { -a, 0.0, -b }, { a, 0.0, -b },
-		{ 0.0, b, a }, { 0.0, b, -a }, { 0.0, -b, a }, { 0.0, -b, -a },
-		{ b, a, 0.0 }, { -b, a, 0.0 }, { b, -a, 0.0 }, { -b, -a, 0.0 }
-	};
-
-	//unit isocahedron
-	constexpr std::array<glm::vec3, 20 * 3> isocahedronMesh = {
-		verts[0], verts[4], verts[1],
-		verts[0], verts[9], verts[4],
-		verts[9], verts[5], verts[4],
-		verts[4], verts[5], verts[8],
-		verts[4], verts[8], verts[1],
-		verts[8], verts[10], verts[1],
-		verts[8], verts[3], verts[10],
-		verts[5], verts[3], verts[8],
-		verts[5], verts[2], verts[3],
-		verts[2], verts[7], verts[3],
-		verts[7], verts[10], verts[3],
-		verts[7], verts[6], verts[10],
-		verts[7], verts[11], verts[6],
-		verts[11], verts[0], verts[6],
-		verts[0], verts[1], verts[6],
-		verts[6], verts[1], verts[10],
-		verts[9], verts[0], verts[11],
-		verts[9], verts[11], verts[2],
-		verts[9], verts[2], verts[5],
-		verts[7], verts[2], verts[11],
-	};
-
-	return isocahedronMesh;
+inline uint16_t packHalf(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint32_t sign = (bits >> 16) & 0x8000;
+	int32_t exponent = (int32_t) ((bits >> 23) & 0xFF) - 127 + 15;
+	uint32_t mantissa = bits & 0x7FFFFF;
+
+	if (exponent <= 0) return (uint16_t) sign;
+	if (exponent >= 31) return (uint16_t) (sign | 0x7C00);
+	// a carry out of the mantissa moves the exponent up, which is still the right rounding
+	return (uint16_t) ((sign | (uint32_t) exponent << 10 | mantissa >> 13) + ((mantissa >> 12) & 1));
 }
 
+// the unit icosahedron, adapted from https://github.com/anishagartia/Icosahedron_OpenGL
+constexpr float icosahedronA = 0.52573f;
+constexpr float icosahedronB = 0.85065f;
+
+constexpr std::array<glm::vec3, 12> icosahedronVertices = {
+	glm::vec3{ -icosahedronA, 0.0f, icosahedronB }, { icosahedronA, 0.0f, icosahedronB },
+	{ -icosahedronA, 0.0f, -icosahedronB }, { icosahedronA, 0.0f, -icosahedronB },
+	{ 0.0f, icosahedronB, icosahedronA }, { 0.0f, icosahedronB, -icosahedronA },
+	{ 0.0f, -icosahedronB, icosahedronA }, { 0.0f, -icosahedronB, -icosahedronA },
+	{ icosahedronB, icosahedronA, 0.0f }, { -icosahedronB, icosahedronA, 0.0f },
+	{ icosahedronB, -icosahedronA, 0.0f }, { -icosahedronB, -icosahedronA, 0.0f }
+};
+
+constexpr std::array<uint8_t, 20 * 3> icosahedronIndices = {
+	0, 4, 1,
+	0, 9, 4,
+	9, 5, 4,
+	4, 5, 8,
+	4, 8, 1,
+	8, 10, 1,
+	8, 3, 10,
+	5, 3, 8,
+	5, 2, 3,
+	2, 7, 3,
+	7, 10, 3,
+	7, 6, 10,
+	7, 11, 6,
+	11, 0, 6,
+	0, 1, 6,
+	6, 1, 10,
+	9, 0, 11,
+	9, 11, 2,
+	9, 2, 5,
+	7, 2, 11
+};
+
+// levels of detail for foods close enough to need a mesh, the icosahedron subdivided once, twice and three times
+// anything smaller on screen than the first level's maxRadius is a quad the fragment shader ray traces a sphere into,
+// which is exact, so every switch is within half a pixel
+constexpr size_t foodLevels = 3;
+
+struct FoodLevel {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	int32_t baseVertex;
+	// largest radius on screen, in pixels, at which the mesh still is within half a pixel of a sphere
+	float maxRadius;
+};
+
+// every level's vertices and indices back to back, uploaded once and drawn indexed and instanced
+struct FoodMesh {
+	std::vector<PackedVertex> vertices;
+	std::vector<uint16_t> indices;
+	std::array<FoodLevel, foodLevels> levels;
+};
+
+// a sphere, so the normals are the positions
 [[nodiscard]]
-constexpr std::array<glm::vec3, 20 * 3> createFoodMesh(glm::vec3 pos, float r) {
-	constexpr std::array<glm::vec3, 20*3> isocahedronMesh = createFoodMesh();
+inline FoodMesh createFoodMesh() {
+	std::vector<glm::vec3> positions(icosahedronVertices.begin(), icosahedronVertices.end());
+	std::vector<uint16_t> triangles(icosahedronIndices.begin(), icosahedronIndices.end());
+
+	FoodMesh out;
+	for (size_t level = 0; level < foodLevels; ++level) {
+		// every triangle into four, the new corners pushed out onto the sphere and shared between neighbours
+		std::map<std::pair<uint16_t, uint16_t>, uint16_t> midpoints;
+		auto midpoint = [&](uint16_t a, uint16_t b) {
+			auto [it, added] = midpoints.try_emplace({ std::min(a, b), std::max(a, b) }, (uint16_t) positions.size());
+			if (added) positions.push_back(glm::normalize(positions[a] + positions[b]));
+			return it->second;
+		};
+		std::vector<uint16_t> split;
+		split.reserve(triangles.size() * 4);
+		for (size_t i = 0; i < triangles.size(); i += 3) {
+			uint16_t a = triangles[i], b = triangles[i + 1], c = triangles[i + 2];
+			uint16_t ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+			split.insert(split.end(), { a, ab, ca, ab, b, bc, ca, bc, c, ab, bc, ca });
+		}
+		triangles = std::move(split);
 
-	std::array<glm::vec3, 20 * 3> out{};
-	for (int i = 0; i < out.size(); ++i) {
-		out[i] = isocahedronMesh[i] * r + pos;
-	}
+		// how far the flattest face sits inside the sphere
+		float error = 0.0f;
+		for (size_t i = 0; i < triangles.size(); i += 3) {
+			glm::vec3 a = positions[triangles[i]], b = positions[triangles[i + 1]], c = positions[triangles[i + 2]];
+			error = glm::max(error, 1.0f - glm::abs(glm::dot(glm::normalize(glm::cross(b - a, c - a)), a)));
+		}
 
+		out.levels[level] = { (uint32_t) out.indices.size(), (uint32_t) triangles.size(), (int32_t) out.vertices.size(), 0.5f / error };
+		for (const auto& pos : positions) {
+			out.vertices.push_back({ { packSnorm16(pos.x), packSnorm16(pos.y), packSnorm16(pos.z), 32767 }, packNormal(pos) });
+		}
+		out.indices.insert(out.indices.end(), triangles.begin(), triangles.end());
+	}
 	return out;
 }
 
-void fillFoodMeshInterleaved(PersistentMappedBuffer& buffer, const glm::vec3& pos, float radius, const glm::vec4& color) {
-	static constexpr auto isocahedronMesh = createFoodMesh();
-
-	static auto normals = createNormals(isocahedronMesh);
-
-	for (int i = 0; i < 20; i++) {
-		glm::vec3 transformed = isocahedronMesh[i * 3] * radius + pos;
-		memcpy(buffer.pointer + buffer.size, &transformed, sizeof(glm::vec3));
-		buffer.size += sizeof(glm::vec3);
-		memcpy(buffer.pointer + buffer.size, &normals[i], sizeof(glm::vec3));
-		buffer.size += sizeof(glm::vec3);
-		memcpy(buffer.pointer + buffer.size, &color, sizeof(glm::vec4));
-		buffer.size += sizeof(glm::vec4);
-
-		transformed = isocahedronMesh[i * 3 + 1] * radius + pos;
-		memcpy(buffer.pointer + buffer.size, &transformed, sizeof(glm::vec3));
-		buffer.size += sizeof(glm::vec3);
-		memcpy(buffer.pointer + buffer.size, &normals[i], sizeof(glm::vec3));
-		buffer.size += sizeof(glm::vec3);
-		memcpy(buffer.pointer + buffer.size, &color, sizeof(glm::vec4));
-		buffer.size += sizeof(glm::vec4);
-
-		transformed = isocahedronMesh[i * 3 + 2] * radius + pos;
-		memcpy(buffer.pointer + buffer.size, &transformed, sizeof(glm::vec3));
-		buffer.size += sizeof(glm::vec3);
-		memcpy(buffer.pointer + buffer.size, &normals[i], sizeof(glm::vec3));
-		buffer.size += sizeof(glm::vec3);
-		memcpy(buffer.pointer + buffer.size, &color, sizeof(glm::vec4));
-		buffer.size += sizeof(glm::vec4);
-	}
+// colors FoodInstanced.vert has, by index
+enum class FoodColor : uint8_t {
+	Red,
+	None
+};
+
+// bytes fillFoodInstance writes, a float vec3 position, a half float radius, a FoodColor and a byte of padding
+constexpr size_t foodInstanceSize = 16;
+
+template <class Buffer>
+void fillFoodInstance(Buffer& buffer, const glm::vec3& pos, float radius, FoodColor color) {
+	uint16_t halfRadius = packHalf(radius);
+	uint8_t colorPadding[2] = { (uint8_t) color, 0 };
+	memcpy(buffer.pointer + buffer.size, &pos, sizeof(glm::vec3));
+	memcpy(buffer.pointer + buffer.size + 12, &halfRadius, sizeof(halfRadius));
+	memcpy(buffer.pointer + buffer.size + 14, colorPadding, sizeof(colorPadding));
+	buffer.size += foodInstanceSize;
 }
 